@@ -0,0 +1,727 @@
+#!/usr/bin/env python3
+"""Fleet simulator and local ingest stand-in for the sensor server.
+
+The stand-in implements the two endpoints used by the firmware:
+
+  POST /devices/register   body: device net_id, replies 200 (or 401 with --deny)
+  POST /devices/send_data  X-SENSOR-ID header, JSON array of readings
+
+and reports request rate, connection churn and server-side latency percentiles.
+With --max-rps it emulates an overloaded backend: requests above that rate in any
+second are answered 503 with a Retry-After header, sent before the other
+headers unless --retry-after-last is given.
+With --tls-cert/--tls-key (or --tls-psk) it terminates TLS itself and also
+reports handshake time, handshake bytes on the wire and the session resumption
+rate.
+
+The fleet mode simulates devices at the protocol level the way the firmware talks
+to the server: one TCP connection per request, the same headers, the net_id
+derived from a 16 byte hardware id and the node's sensor names (SHA1), register
+with full jitter backoff, upload a sample taken at boot, then one JSON array per
+interval at a phase derived from the net_id, honouring 503/429 Retry-After.
+--legacy-backoff restores the older lockstep behaviour (doubling backoff, no phase,
+Retry-After ignored) for comparison.
+
+Examples:
+
+  fleet_sim.py ingest --listen 0.0.0.0:8000
+  fleet_sim.py fleet --server 127.0.0.1:8000 --devices 500 --interval 60
+  fleet_sim.py both --devices 500 --interval 10 --duration 120
+  fleet_sim.py both --devices 500 --interval 60 --max-rps 50 --retry-after 5 --duration 300
+  fleet_sim.py ingest --listen 0.0.0.0:8443 --tls-cert server.pem --tls-key server.key
+  fleet_sim.py poll --target 192.0.2.1:8080 --concurrency 8 --duration 60
+"""
+
+import argparse
+import asyncio
+import hashlib
+import json
+import random
+import signal
+import ssl
+import sys
+import time
+
+AUTHORIZE_URL = "/devices/register"
+POST_READING_URL = "/devices/send_data"
+DEV_ID_HEADER = "x-sensor-id"
+TLS_PSK_ID = "sensor"
+
+
+def percentile(values, pct):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    idx = min(len(values) - 1, max(0, int(round(pct / 100.0 * len(values) + 0.5)) - 1))
+    return values[idx]
+
+
+class IngestStats:
+    def __init__(self):
+        self.requests = 0
+        self.conns_opened = 0
+        self.conns_closed = 0
+        self.open = 0
+        self.status = {}
+        self.latencies = []
+        self.window_latencies = []
+        self.window_requests = 0
+        self.window_conns = 0
+        self.per_second = {}
+        self.handshakes = []
+        self.window_handshakes = []
+        self.tls_failures = 0
+        self.started = time.monotonic()
+
+    def record(self, status, latency):
+        self.requests += 1
+        self.window_requests += 1
+        self.status[status] = self.status.get(status, 0) + 1
+        second = int(time.monotonic() - self.started)
+        self.per_second[second] = self.per_second.get(second, 0) + 1
+        self.latencies.append(latency)
+        self.window_latencies.append(latency)
+
+    def record_handshake(self, info):
+        self.handshakes.append(info)
+        self.window_handshakes.append(info)
+
+    def window_report(self, period):
+        lat = self.window_latencies
+        line = (
+            f"t={time.monotonic() - self.started:7.1f}s "
+            f"rps={self.window_requests / period:8.1f} "
+            f"conn/s={self.window_conns / period:8.1f} open={self.open:4d} "
+            f"p50={percentile(lat, 50) * 1e3:7.2f}ms "
+            f"p99={percentile(lat, 99) * 1e3:7.2f}ms "
+            f"max={max(lat, default=0) * 1e3:7.2f}ms"
+        )
+        if self.window_handshakes:
+            hs = self.window_handshakes
+            line += (
+                f" tls={len(hs)} resumed={sum(h['resumed'] for h in hs)}"
+                f" hs_p50={percentile([h['time'] for h in hs], 50) * 1e3:.2f}ms"
+            )
+        self.window_handshakes = []
+        self.window_latencies = []
+        self.window_requests = 0
+        self.window_conns = 0
+        return line
+
+    def summary(self):
+        elapsed = time.monotonic() - self.started
+        lat = self.latencies
+        return {
+            "elapsed_s": round(elapsed, 3),
+            "requests": self.requests,
+            "rps": round(self.requests / elapsed, 2) if elapsed else 0,
+            "peak_rps": max(self.per_second.values(), default=0),
+            "connections": self.conns_opened,
+            "conn_per_s": round(self.conns_opened / elapsed, 2) if elapsed else 0,
+            "status": {str(k): v for k, v in sorted(self.status.items())},
+            "latency_ms": {
+                "p50": round(percentile(lat, 50) * 1e3, 3),
+                "p90": round(percentile(lat, 90) * 1e3, 3),
+                "p99": round(percentile(lat, 99) * 1e3, 3),
+                "p999": round(percentile(lat, 99.9) * 1e3, 3),
+                "max": round(max(lat, default=0) * 1e3, 3),
+            },
+            "tls": handshake_summary(self.handshakes, self.tls_failures),
+        }
+
+
+def handshake_summary(handshakes, failures):
+    """Handshake time and wire bytes, split by full and resumed handshakes."""
+    if not handshakes and not failures:
+        return None
+
+    summary = {"handshakes": len(handshakes), "failures": failures}
+    for kind, resumed in (("full", False), ("resumed", True)):
+        hs = [h for h in handshakes if h["resumed"] == resumed]
+        if not hs:
+            continue
+        times = [h["time"] for h in hs]
+        summary[kind] = {
+            "count": len(hs),
+            "time_ms_p50": round(percentile(times, 50) * 1e3, 3),
+            "time_ms_p99": round(percentile(times, 99) * 1e3, 3),
+            "bytes_in_avg": round(sum(h["rx"] for h in hs) / len(hs)),
+            "bytes_out_avg": round(sum(h["tx"] for h in hs) / len(hs)),
+        }
+    return summary
+
+
+class TlsWriter:
+    """Stream writer stand-in encrypting through an SSLObject."""
+
+    def __init__(self, tls, outgoing, writer):
+        self.tls = tls
+        self.outgoing = outgoing
+        self.writer = writer
+
+    def write(self, data):
+        self.tls.write(data)
+        self.writer.write(self.outgoing.read())
+
+    async def drain(self):
+        await self.writer.drain()
+
+    def close(self):
+        try:
+            self.tls.unwrap()
+        except ssl.SSLError:
+            pass
+        self.writer.write(self.outgoing.read())
+        self.writer.close()
+
+
+async def tls_wrap(reader, writer, ctx, server_side, hostname=None, session=None):
+    """Run a TLS handshake over a plain stream, counting its time and wire bytes.
+
+    Returns a (reader, writer, info) triple carrying the decrypted stream.
+    """
+    incoming, outgoing = ssl.MemoryBIO(), ssl.MemoryBIO()
+    tls = ctx.wrap_bio(incoming, outgoing, server_side, hostname, session)
+    rx = tx = 0
+    start = time.monotonic()
+
+    while True:
+        try:
+            tls.do_handshake()
+            break
+        except ssl.SSLWantReadError:
+            data = outgoing.read()
+            tx += len(data)
+            writer.write(data)
+            await writer.drain()
+            data = await reader.read(4096)
+            if not data:
+                raise ConnectionError("closed during handshake")
+            rx += len(data)
+            incoming.write(data)
+
+    data = outgoing.read()
+    tx += len(data)
+    writer.write(data)
+    await writer.drain()
+
+    info = {"time": time.monotonic() - start, "rx": rx, "tx": tx,
+            "resumed": tls.session_reused, "session": tls.session}
+
+    plain = asyncio.StreamReader()
+
+    async def pump():
+        try:
+            while True:
+                try:
+                    data = tls.read(4096)
+                    if not data:
+                        break
+                    plain.feed_data(data)
+                    continue
+                except ssl.SSLWantReadError:
+                    pass
+                data = await reader.read(4096)
+                if not data:
+                    break
+                incoming.write(data)
+        except (ssl.SSLZeroReturnError, ssl.SSLError, ConnectionError):
+            pass
+        plain.feed_eof()
+
+    info["pump"] = asyncio.create_task(pump())
+    return plain, TlsWriter(tls, outgoing, writer), info
+
+
+def tls_context(args, server_side):
+    if not (args.tls_cert or args.tls_psk):
+        return None
+
+    ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER if server_side else ssl.PROTOCOL_TLS_CLIENT)
+    # The firmware speaks TLS 1.2, where session IDs and tickets are both visible here.
+    ctx.maximum_version = ssl.TLSVersion.TLSv1_2
+
+    if args.tls_psk:
+        if not hasattr(ctx, "set_psk_server_callback"):
+            sys.exit("--tls-psk needs Python 3.13 or newer")
+        key = bytes.fromhex(args.tls_psk)
+        ctx.set_ciphers("PSK")
+        if server_side:
+            ctx.set_psk_server_callback(lambda identity: key if identity == TLS_PSK_ID else b"")
+        else:
+            ctx.check_hostname = False
+            ctx.verify_mode = ssl.CERT_NONE
+            ctx.set_psk_client_callback(lambda hint: (TLS_PSK_ID, key))
+    elif server_side:
+        ctx.load_cert_chain(args.tls_cert, args.tls_key)
+    else:
+        ctx.load_verify_locations(args.tls_ca or args.tls_cert)
+
+    return ctx
+
+
+async def read_message(reader):
+    """Parse one HTTP/1.1 message; returns (start line fields, headers, body) or None."""
+    line = await reader.readline()
+    if not line:
+        return None
+    start = line.decode("latin-1").rstrip("\r\n").split(" ", 2)
+
+    headers = {}
+    while True:
+        line = await reader.readline()
+        if line in (b"\r\n", b"\n", b""):
+            break
+        name, _, value = line.decode("latin-1").partition(":")
+        headers[name.strip().lower()] = value.strip()
+
+    # The firmware's HTTP client sends Content-Length alongside its chunked header and
+    # a raw body, so the length wins here.
+    if "content-length" in headers:
+        body = await reader.readexactly(int(headers["content-length"]))
+    elif headers.get("transfer-encoding", "").lower() == "chunked":
+        body = b""
+        while True:
+            size = int((await reader.readline()).split(b";")[0], 16)
+            chunk = await reader.readexactly(size + 2)
+            if size == 0:
+                break
+            body += chunk[:-2]
+    else:
+        body = b""
+
+    return start, headers, body
+
+
+async def read_request(reader):
+    """Parse one HTTP/1.1 request; returns (method, path, headers, body) or None."""
+    message = await read_message(reader)
+    if message is None:
+        return None
+    (method, path, _), headers, body = message
+    return method, path, headers, body
+
+
+class Ingest:
+    def __init__(self, args):
+        self.args = args
+        self.stats = IngestStats()
+        self.tls = tls_context(args, server_side=True)
+        self.devices = set()
+        self.readings = 0
+        self.slot = None
+        self.slot_requests = 0
+
+    def overloaded(self):
+        if not self.args.max_rps:
+            return False
+        slot = int(time.monotonic())
+        if slot != self.slot:
+            self.slot, self.slot_requests = slot, 0
+        self.slot_requests += 1
+        return self.slot_requests > self.args.max_rps
+
+    def handle(self, method, path, headers, body):
+        if method != "POST":
+            return 405
+        if path == AUTHORIZE_URL:
+            if self.args.deny:
+                return 401
+            self.devices.add(body.decode("latin-1").strip())
+            return 200
+        if path == POST_READING_URL:
+            if headers.get(DEV_ID_HEADER) not in self.devices:
+                return 401
+            try:
+                self.readings += len(json.loads(body))
+            except ValueError:
+                return 400
+            return 200
+        return 404
+
+    async def serve_client(self, reader, writer):
+        self.stats.conns_opened += 1
+        self.stats.window_conns += 1
+        self.stats.open += 1
+        try:
+            if self.tls:
+                try:
+                    reader, writer, info = await tls_wrap(reader, writer, self.tls, True)
+                except (ssl.SSLError, ConnectionError, OSError):
+                    self.stats.tls_failures += 1
+                    raise ConnectionError("handshake failed")
+                self.stats.record_handshake(info)
+            while True:
+                request = await read_request(reader)
+                if request is None:
+                    break
+                start = time.monotonic()
+                status = 503 if self.overloaded() else self.handle(*request)
+                if self.args.delay_ms:
+                    await asyncio.sleep(self.args.delay_ms / 1e3)
+                headers = ["Content-Length: 0", "Connection: close"]
+                if status == 503:
+                    retry_after = f"Retry-After: {self.args.retry_after}"
+                    if self.args.retry_after_last:
+                        headers.append(retry_after)
+                    else:
+                        headers.insert(0, retry_after)
+                writer.write(
+                    (f"HTTP/1.1 {status} X\r\n" + "".join(f"{h}\r\n" for h in headers) + "\r\n")
+                    .encode()
+                )
+                await writer.drain()
+                self.stats.record(status, time.monotonic() - start)
+                break
+        except (ConnectionError, asyncio.IncompleteReadError, ValueError):
+            pass
+        finally:
+            self.stats.open -= 1
+            self.stats.conns_closed += 1
+            writer.close()
+
+    async def report(self):
+        while True:
+            await asyncio.sleep(self.args.report)
+            print("ingest " + self.stats.window_report(self.args.report), flush=True)
+
+    async def start(self):
+        host, port = self.args.listen.rsplit(":", 1)
+        server = await asyncio.start_server(
+            self.serve_client, host, int(port), backlog=self.args.backlog
+        )
+        print(f"ingest listening on {self.args.listen}", flush=True)
+        return server, asyncio.create_task(self.report())
+
+
+class Device:
+    def __init__(self, idx, args, client_stats):
+        rng = random.Random(args.seed * 1000003 + idx)
+        self.args = args
+        self.dev_id = bytes(rng.getrandbits(8) for _ in range(16))
+        self.sensors = args.sensors.split(",")
+        sha1 = hashlib.sha1(self.dev_id)
+        for sensor in self.sensors:
+            sha1.update(sensor.encode())
+        self.net_id = sha1.hexdigest()
+        # the firmware offsets its sampling timer by the first net_id word modulo the period
+        self.phase = int(self.net_id[:8], 16) % max(1, int(args.interval * 1e3)) / 1e3
+        self.rng = rng
+        self.stats = client_stats
+        self.tls = tls_context(args, server_side=False)
+        self.session = None
+
+    def payload(self):
+        readings = [
+            {"sensor": s, "type": "temp", "value": self.rng.randint(-(2**31), 2**31 - 1), "shift": 6}
+            for s in self.sensors
+        ]
+        return json.dumps(readings, separators=(",", ":")).encode()
+
+    async def request(self, url, headers, body, content_type):
+        host, port = self.args.server.rsplit(":", 1)
+        start = time.monotonic()
+        try:
+            reader, writer = await asyncio.wait_for(
+                asyncio.open_connection(host, int(port)), self.args.timeout
+            )
+        except (OSError, asyncio.TimeoutError):
+            self.stats["connect_errors"] += 1
+            return None
+        try:
+            if self.tls:
+                reader, writer, info = await tls_wrap(
+                    reader, writer, self.tls, False, self.args.tls_hostname,
+                    self.session if self.args.tls_resume else None,
+                )
+                self.session = info["session"]
+                self.stats["handshakes"].append(info)
+            head = (
+                f"POST {url} HTTP/1.1\r\nHost: {host}\r\n"
+                "Transfer-Encoding: chunked\r\n"
+                + "".join(f"{h}\r\n" for h in headers)
+                + f"Content-Type: {content_type}\r\nContent-Length: {len(body)}\r\n\r\n"
+            )
+            writer.write(head.encode() + body)
+            await writer.drain()
+            line = await asyncio.wait_for(reader.readline(), self.args.timeout)
+            status = int(line.split()[1])
+            retry_after = 0
+            while True:
+                header = await asyncio.wait_for(reader.readline(), self.args.timeout)
+                if header in (b"\r\n", b"\n", b""):
+                    break
+                name, _, value = header.decode("latin-1").partition(":")
+                if name.strip().lower() == "retry-after" and value.strip().isdigit():
+                    retry_after = min(int(value), self.args.retry_delay_max)
+        except (OSError, asyncio.TimeoutError, IndexError, ValueError, ssl.SSLError):
+            self.stats["request_errors"] += 1
+            return None, 0
+        finally:
+            writer.close()
+        self.stats["latencies"].append(time.monotonic() - start)
+        return status, retry_after
+
+    def retry_delay(self, cap, retry_after):
+        """Mirrors retry_delay_ms() in the firmware."""
+        if retry_after:
+            return retry_after + self.rng.uniform(0, retry_after)
+        return self.rng.uniform(0, cap)
+
+    async def authorize(self):
+        cap = self.args.retry_delay
+        while True:
+            status, retry_after = await self.request(
+                AUTHORIZE_URL, [], self.net_id.encode(), "text/plain"
+            )
+            if status == 200:
+                return
+            self.stats["retries"] += 1
+            if self.args.legacy_backoff:
+                await asyncio.sleep(cap)
+            else:
+                await asyncio.sleep(self.retry_delay(cap, retry_after))
+            cap = min(2 * cap, self.args.retry_delay_max)
+
+    async def run(self):
+        await asyncio.sleep(self.rng.uniform(0, self.args.boot_spread))
+        legacy = self.args.legacy_backoff
+        period = self.args.interval
+        # the firmware samples at boot and runs its timer at the device phase from then on
+        boot = time.monotonic()
+        await self.authorize()
+        next_tick = time.monotonic() + period if legacy else boot + (self.phase or period)
+        while True:
+            status, retry_after = await self.request(
+                POST_READING_URL, [f"X-SENSOR-ID: {self.net_id}"], self.payload(), "application/json"
+            )
+            self.stats["uploads"] += 1
+            if status == 401:
+                await self.authorize()
+            elif status in (429, 503) and not legacy:
+                self.stats["held_off"] += 1
+                await asyncio.sleep(self.retry_delay(self.args.retry_delay, retry_after))
+            now = time.monotonic()
+            if not legacy:
+                # ticks missed while held off coalesce into the next one, like the firmware
+                while next_tick < now:
+                    next_tick += period
+            await asyncio.sleep(max(0, next_tick - now))
+            next_tick += period
+
+
+async def run_fleet(args):
+    stats = {
+        "uploads": 0,
+        "retries": 0,
+        "held_off": 0,
+        "connect_errors": 0,
+        "request_errors": 0,
+        "latencies": [],
+        "handshakes": [],
+    }
+    devices = [Device(idx, args, stats) for idx in range(args.devices)]
+    print(f"fleet: {len(devices)} devices -> {args.server}", flush=True)
+    return stats, [asyncio.create_task(dev.run()) for dev in devices]
+
+
+def fleet_summary(stats):
+    lat = stats["latencies"]
+    return {
+        "uploads": stats["uploads"],
+        "retries": stats["retries"],
+        "held_off": stats["held_off"],
+        "connect_errors": stats["connect_errors"],
+        "request_errors": stats["request_errors"],
+        "client_latency_ms": {
+            "p50": round(percentile(lat, 50) * 1e3, 3),
+            "p99": round(percentile(lat, 99) * 1e3, 3),
+            "max": round(max(lat, default=0) * 1e3, 3),
+        },
+        "tls": handshake_summary(stats["handshakes"], 0),
+    }
+
+
+class Poller:
+    """Local pull mode: concurrent GET loops against the device snapshot server."""
+
+    def __init__(self, args):
+        self.args = args
+        self.latencies = []
+        self.window_latencies = []
+        self.errors = 0
+        self.connections = 0
+        self.bytes = 0
+        self.started = time.monotonic()
+
+    async def worker(self):
+        host, port = self.args.target.rsplit(":", 1)
+        reader = writer = None
+        request = (
+            f"GET {self.args.path} HTTP/1.1\r\nHost: {host}\r\n"
+            + ("Connection: close\r\n" if self.args.new_conn else "")
+            + "\r\n"
+        ).encode()
+
+        while True:
+            try:
+                if writer is None:
+                    reader, writer = await asyncio.wait_for(
+                        asyncio.open_connection(host, int(port)), self.args.timeout
+                    )
+                    self.connections += 1
+                start = time.monotonic()
+                writer.write(request)
+                await writer.drain()
+                message = await asyncio.wait_for(read_message(reader), self.args.timeout)
+                if message is None:
+                    raise ConnectionError("closed")
+                (version, status, _), headers, body = message
+                if status != "200":
+                    self.errors += 1
+                latency = time.monotonic() - start
+                self.latencies.append(latency)
+                self.window_latencies.append(latency)
+                self.bytes += len(body)
+                if (
+                    self.args.new_conn
+                    or version == "HTTP/1.0"
+                    or headers.get("connection", "").lower() == "close"
+                ):
+                    writer.close()
+                    writer = None
+            except (OSError, asyncio.TimeoutError, asyncio.IncompleteReadError, ValueError):
+                self.errors += 1
+                if writer:
+                    writer.close()
+                writer = None
+                await asyncio.sleep(0.1)
+
+    async def report(self):
+        while True:
+            await asyncio.sleep(self.args.report)
+            lat = self.window_latencies
+            print(
+                f"poll t={time.monotonic() - self.started:7.1f}s "
+                f"rps={len(lat) / self.args.report:8.1f} errors={self.errors} "
+                f"p50={percentile(lat, 50) * 1e3:7.2f}ms p99={percentile(lat, 99) * 1e3:7.2f}ms",
+                flush=True,
+            )
+            self.window_latencies = []
+
+    def start(self):
+        print(f"poll: {self.args.concurrency} clients -> {self.args.target}", flush=True)
+        tasks = [asyncio.create_task(self.worker()) for _ in range(self.args.concurrency)]
+        return tasks + [asyncio.create_task(self.report())]
+
+    def summary(self):
+        elapsed = time.monotonic() - self.started
+        lat = self.latencies
+        return {
+            "elapsed_s": round(elapsed, 3),
+            "requests": len(lat),
+            "rps": round(len(lat) / elapsed, 2) if elapsed else 0,
+            "errors": self.errors,
+            "connections": self.connections,
+            "bytes_avg": round(self.bytes / len(lat)) if lat else 0,
+            "latency_ms": {
+                "p50": round(percentile(lat, 50) * 1e3, 3),
+                "p99": round(percentile(lat, 99) * 1e3, 3),
+                "max": round(max(lat, default=0) * 1e3, 3),
+            },
+        }
+
+
+async def main(args):
+    stop = asyncio.Event()
+    loop = asyncio.get_running_loop()
+    for sig in (signal.SIGINT, signal.SIGTERM):
+        loop.add_signal_handler(sig, stop.set)
+
+    ingest = server = None
+    tasks = []
+    fleet_stats = None
+
+    if args.mode in ("ingest", "both"):
+        ingest = Ingest(args)
+        server, report = await ingest.start()
+        tasks.append(report)
+        if args.mode == "both":
+            args.server = args.listen
+
+    if args.mode in ("fleet", "both"):
+        fleet_stats, fleet_tasks = await run_fleet(args)
+        tasks += fleet_tasks
+
+    poller = None
+    if args.mode == "poll":
+        poller = Poller(args)
+        tasks += poller.start()
+
+    try:
+        await asyncio.wait_for(stop.wait(), args.duration or None)
+    except asyncio.TimeoutError:
+        pass
+
+    for task in tasks:
+        task.cancel()
+    await asyncio.gather(*tasks, return_exceptions=True)
+    if server:
+        server.close()
+
+    summary = {}
+    if ingest:
+        summary["ingest"] = ingest.stats.summary()
+        summary["ingest"]["devices"] = len(ingest.devices)
+        summary["ingest"]["readings"] = ingest.readings
+    if fleet_stats:
+        summary["fleet"] = fleet_summary(fleet_stats)
+    if poller:
+        summary["poll"] = poller.summary()
+    json.dump(summary, sys.stdout, indent=2)
+    print()
+
+
+def parse_args():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n\n")[0])
+    parser.add_argument("mode", choices=("ingest", "fleet", "both", "poll"))
+    parser.add_argument("--listen", default="127.0.0.1:8000", help="ingest address")
+    parser.add_argument("--backlog", type=int, default=1024, help="ingest listen backlog")
+    parser.add_argument("--deny", action="store_true", help="reject every registration")
+    parser.add_argument("--delay-ms", type=float, default=0, help="added ingest processing time")
+    parser.add_argument("--max-rps", type=int, default=0,
+                        help="answer 503 above this many requests per second, 0 is unlimited")
+    parser.add_argument("--retry-after", type=int, default=10, help="Retry-After of 503s (s)")
+    parser.add_argument("--retry-after-last", action="store_true",
+                        help="send Retry-After as the last header instead of the first")
+    parser.add_argument("--report", type=float, default=5, help="ingest report period (s)")
+    parser.add_argument("--server", default="127.0.0.1:8000", help="fleet target address")
+    parser.add_argument("--devices", type=int, default=100)
+    parser.add_argument("--sensors", default="bmp180@77,dht22,bh1750@23",
+                        help="comma separated sensor node names (part of net_id)")
+    parser.add_argument("--interval", type=float, default=300, help="upload interval (s)")
+    parser.add_argument("--boot-spread", type=float, default=0,
+                        help="devices start uniformly within this window (s), 0 is lockstep")
+    parser.add_argument("--retry-delay", type=float, default=60, help="initial retry delay (s)")
+    parser.add_argument("--retry-delay-max", type=float, default=1800, help="max retry delay (s)")
+    parser.add_argument("--legacy-backoff", action="store_true",
+                        help="fleet without phase offsets, jitter or Retry-After")
+    parser.add_argument("--timeout", type=float, default=30, help="network timeout (s)")
+    parser.add_argument("--duration", type=float, default=0, help="run time (s), 0 until ^C")
+    parser.add_argument("--seed", type=int, default=1, help="device id seed")
+    parser.add_argument("--target", default="192.0.2.1:8080", help="poll snapshot server")
+    parser.add_argument("--path", default="/snapshot", help="poll resource")
+    parser.add_argument("--concurrency", type=int, default=4, help="poll clients")
+    parser.add_argument("--new-conn", action="store_true", help="poll with one connection per request")
+    parser.add_argument("--tls-cert", help="ingest certificate chain (PEM), enables TLS")
+    parser.add_argument("--tls-key", help="ingest private key (PEM)")
+    parser.add_argument("--tls-ca", help="fleet CA certificate (PEM), defaults to --tls-cert")
+    parser.add_argument("--tls-hostname", default="sensor-server", help="fleet TLS server name")
+    parser.add_argument("--tls-psk", help=f"hex pre-shared key for identity '{TLS_PSK_ID}'")
+    parser.add_argument("--tls-resume", action=argparse.BooleanOptionalAction, default=True,
+                        help="fleet devices resume their previous TLS session")
+    return parser.parse_args()
+
+
+if __name__ == "__main__":
+    asyncio.run(main(parse_args()))
@@ -0,0 +1,246 @@
+#include "alert.h"
+#include "sensor_map.h"
+#include "storage.h"
+#include "zbus.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/zbus/zbus.h>
+
+LOG_MODULE_REGISTER(alert, CONFIG_APP_LOG_LEVEL);
+
+#define ALERT_RULES_MAX CONFIG_APP_ALERT_RULES_MAX
+
+BUILD_ASSERT(SENSOR_READINGS_MAX <= UINT8_MAX, "Too many channels");
+
+/* clang-format off */
+ZBUS_CHAN_DEFINE(alert_chan,		/* Name */
+	 struct sensor_alert,			/* Message */
+	 NULL,							/* Validator */
+	 NULL,					 		/* User data */
+	 ZBUS_OBSERVERS_EMPTY,	 		/* Observers */
+	 ZBUS_MSG_INIT(0)		 		/* Initial value */
+);
+/* clang-format on */
+
+static K_MUTEX_DEFINE(alert_lock);
+static struct alert_rule rules[ALERT_RULES_MAX];
+static size_t rule_count;
+
+/* Rules fire once when their condition starts to hold and re-arm when it stops. */
+static bool rule_active[ALERT_RULES_MAX];
+
+static int64_t prev_value[SENSOR_READINGS_MAX];
+static bool prev_valid[SENSOR_READINGS_MAX];
+
+static const char *const op_names[ALERT_OP_COUNT] = {
+	[ALERT_OP_ABOVE] = "above",
+	[ALERT_OP_BELOW] = "below",
+	[ALERT_OP_RATE] = "rate",
+};
+
+const char *alert_op_name(enum alert_op op)
+{
+	return op < ALERT_OP_COUNT ? op_names[op] : "unknown";
+}
+
+int alert_op_parse(const char *name)
+{
+	for (enum alert_op op = 0; op < ALERT_OP_COUNT; ++op) {
+		if (!strcmp(name, op_names[op])) {
+			return op;
+		}
+	}
+
+	return -EINVAL;
+}
+
+static int alert_save()
+{
+	ssize_t rc;
+
+	rc = storage_alerts_set(rules, rule_count * sizeof(rules[0]));
+	if (rc < 0) {
+		LOG_ERR("failed to store alert rules (err %zd)", rc);
+		return rc;
+	}
+
+	return 0;
+}
+
+int alert_rule_add(const struct alert_rule *rule)
+{
+	int rc;
+
+	if (rule->chan >= SENSOR_READINGS_MAX || rule->op >= ALERT_OP_COUNT) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&alert_lock, K_FOREVER);
+
+	if (rule_count == ALERT_RULES_MAX) {
+		rc = -ENOSPC;
+		goto _unlock;
+	}
+
+	rules[rule_count] = *rule;
+	rule_active[rule_count] = false;
+	rule_count++;
+
+	rc = alert_save();
+	if (rc) {
+		rule_count--;
+	}
+
+_unlock:
+	k_mutex_unlock(&alert_lock);
+	return rc;
+}
+
+int alert_rule_del(size_t idx)
+{
+	int rc;
+
+	k_mutex_lock(&alert_lock, K_FOREVER);
+
+	if (idx >= rule_count) {
+		rc = -EINVAL;
+		goto _unlock;
+	}
+
+	memmove(&rules[idx], &rules[idx + 1], (rule_count - idx - 1) * sizeof(rules[0]));
+	memmove(&rule_active[idx], &rule_active[idx + 1],
+		(rule_count - idx - 1) * sizeof(rule_active[0]));
+	rule_count--;
+
+	rc = alert_save();
+
+_unlock:
+	k_mutex_unlock(&alert_lock);
+	return rc;
+}
+
+int alert_rule_get(size_t idx, struct alert_rule *rule)
+{
+	int rc = 0;
+
+	k_mutex_lock(&alert_lock, K_FOREVER);
+
+	if (idx < rule_count) {
+		*rule = rules[idx];
+	} else {
+		rc = -ENOENT;
+	}
+
+	k_mutex_unlock(&alert_lock);
+	return rc;
+}
+
+/* value * 2^(shift - 31) scaled to milli-units. */
+static int64_t alert_milli(q31_t value, int8_t shift)
+{
+	int64_t milli = (int64_t)value * 1000;
+
+	if (shift > 31) {
+		return milli * BIT64(MIN(shift - 31, 16));
+	}
+	/* milli fits in 42 bits, so anything past a 63 bit shift is 0 (or -1) anyway. */
+	return milli >> MIN(31 - shift, 63);
+}
+
+static bool alert_eval(const struct alert_rule *rule, int64_t value, bool prev_ok, int64_t prev)
+{
+	switch (rule->op) {
+	case ALERT_OP_ABOVE:
+		return value > rule->threshold;
+	case ALERT_OP_BELOW:
+		return value < rule->threshold;
+	case ALERT_OP_RATE:
+		return prev_ok && (value > prev ? value - prev : prev - value) >= rule->threshold;
+	default:
+		return false;
+	}
+}
+
+void alert_check(const struct sensor_reading *reading, uint32_t seq, int64_t timestamp)
+{
+	struct alert_rule fired_rules[ALERT_RULES_MAX];
+	uint8_t fired_idx[ALERT_RULES_MAX];
+	size_t fired_count = 0;
+	struct sensor_alert alert;
+	int64_t value;
+	bool fired;
+	int rc;
+
+	if (reading->chan >= SENSOR_READINGS_MAX) {
+		return;
+	}
+
+	value = alert_milli(reading->value, reading->shift);
+
+	k_mutex_lock(&alert_lock, K_FOREVER);
+
+	for (size_t idx = 0; idx < rule_count; ++idx) {
+		if (rules[idx].chan != reading->chan) {
+			continue;
+		}
+
+		fired = alert_eval(&rules[idx], value, prev_valid[reading->chan],
+				   prev_value[reading->chan]);
+		if (!fired || rule_active[idx]) {
+			rule_active[idx] = fired;
+			continue;
+		}
+		rule_active[idx] = true;
+
+		fired_rules[fired_count] = rules[idx];
+		fired_idx[fired_count++] = idx;
+	}
+
+	prev_value[reading->chan] = value;
+	prev_valid[reading->chan] = true;
+
+	k_mutex_unlock(&alert_lock);
+
+	/* Published unlocked, so a slow observer never holds up rule edits from the shell. */
+	for (size_t i = 0; i < fired_count; ++i) {
+		alert = (struct sensor_alert){
+			.reading = *reading,
+			.seq = seq,
+			.timestamp = timestamp,
+			.rule = fired_idx[i],
+			.op = fired_rules[i].op,
+		};
+
+		LOG_INF("alert: %s %s %s %d", reading->sensor, reading->type,
+			alert_op_name(fired_rules[i].op), fired_rules[i].threshold);
+
+		rc = zbus_chan_pub(&alert_chan, &alert, K_MSEC(100));
+		if (rc) {
+			LOG_WRN("failed to publish alert (err %d)", rc);
+		}
+	}
+}
+
+static int alert_init()
+{
+	ssize_t rc;
+
+	rc = storage_alerts_get(rules, sizeof(rules));
+	if (rc > 0 && rc % sizeof(rules[0]) == 0) {
+		rule_count = rc / sizeof(rules[0]);
+	}
+
+	LOG_INF("%zu alert rule(s)", rule_count);
+
+	return 0;
+}
+
+SYS_INIT(alert_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
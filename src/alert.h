@@ -0,0 +1,32 @@
+#ifndef _ALERT_H
+#define _ALERT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct sensor_reading;
+
+enum alert_op {
+	ALERT_OP_ABOVE,
+	ALERT_OP_BELOW,
+	ALERT_OP_RATE,
+	ALERT_OP_COUNT,
+};
+
+/* Thresholds are in milli-units of the channel; rate is the change between two rounds. */
+struct alert_rule {
+	uint8_t chan;
+	uint8_t op;
+	int32_t threshold;
+};
+
+int alert_rule_add(const struct alert_rule *rule);
+int alert_rule_del(size_t idx);
+int alert_rule_get(size_t idx, struct alert_rule *rule);
+
+const char *alert_op_name(enum alert_op op);
+int alert_op_parse(const char *name);
+
+void alert_check(const struct sensor_reading *reading, uint32_t seq, int64_t timestamp);
+
+#endif // _ALERT_H
@@ -0,0 +1,524 @@
+#include "bench.h"
+#include "http.h"
+#include "sensor.h"
+#include "sensor_map.h"
+#include "storage.h"
+#include "zbus.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/rtio/rtio.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/zbus/zbus.h>
+
+#include <mbedtls/sha1.h>
+
+LOG_MODULE_REGISTER(bench, CONFIG_APP_LOG_LEVEL);
+
+#define BENCH_ITERATIONS CONFIG_APP_BENCH_ITERATIONS
+#define BENCH_BUF_SIZE   MAX(SENSOR_BUF_BLOCK_SIZE, 128)
+#define BENCH_SAMPLES    CONFIG_APP_BENCH_SAMPLES_MAX
+#define BENCH_SHA1_CHUNK 1024
+#define BENCH_NVS_SIZE   16
+
+/* Reads share the iodevs with the sensor thread, which is held off for the measurement. */
+#define BENCH_SENSOR_LOCK_TIMEOUT K_SECONDS(10)
+
+RTIO_DEFINE(bench_ctx, 1, 1);
+
+static uint8_t bench_bufs[SENSOR_COUNT][BENCH_BUF_SIZE];
+static bool bench_read_ok[SENSOR_COUNT];
+static char bench_json[CONFIG_APP_MAX_JSON_PAYLOAD];
+static struct device_sensor_msg bench_msg;
+static volatile uintptr_t bench_sink;
+static uint32_t bench_samples[BENCH_SAMPLES];
+static uint8_t bench_sha1_buf[BENCH_SHA1_CHUNK];
+
+static void bench_listener_cb(const struct zbus_channel *chan)
+{
+	bench_sink++;
+}
+
+ZBUS_LISTENER_DEFINE(bench_listener, bench_listener_cb);
+
+/* clang-format off */
+ZBUS_CHAN_DEFINE(bench_chan,		/* Name */
+	 struct device_sensor_msg,		/* Message */
+	 NULL,							/* Validator */
+	 NULL,							/* User data */
+	 ZBUS_OBSERVERS(bench_listener),	/* Observers */
+	 ZBUS_MSG_INIT(0)				/* Initial value */
+);
+/* clang-format on */
+
+static int bench_report(bench_report_cb_t cb, void *user_data, const char *name, uint32_t size,
+			uint32_t ops, uint32_t cycles, uint64_t bytes, uint32_t max_cycles,
+			uint32_t max_bytes)
+{
+	struct bench_result res = {
+		.name = name,
+		.size = size,
+		.ops = ops,
+	};
+
+	if (ops) {
+		res.cycles_per_op = cycles / ops;
+		res.ns_per_op = k_cyc_to_ns_floor64(cycles) / ops;
+		res.bytes_per_op = bytes / ops;
+	}
+
+	res.pass = (!max_cycles || res.cycles_per_op <= max_cycles) &&
+		   (!max_bytes || res.bytes_per_op <= max_bytes);
+
+	cb(&res, user_data);
+
+	return res.pass ? 0 : -ERANGE;
+}
+
+/* Reads every sensor once into its bench buffer, noting which reads succeeded. */
+static int bench_sensors_read()
+{
+	struct sensor_read_config *cfg;
+	struct rtio_iodev *iodev;
+	int rc;
+
+	rc = sensor_lock(BENCH_SENSOR_LOCK_TIMEOUT);
+	if (rc) {
+		LOG_WRN("sensor thread busy (err %d)", rc);
+		return rc;
+	}
+
+	for (size_t idx = 0; idx < SENSOR_COUNT; ++idx) {
+		iodev = sensor_iodev_get(idx);
+		cfg = (struct sensor_read_config *)(iodev->data);
+
+		rc = sensor_read(iodev, &bench_ctx, bench_bufs[idx], sizeof(bench_bufs[idx]));
+		if (rc) {
+			LOG_WRN("%s: read failed (err %d)", cfg->sensor->name, rc);
+		}
+		bench_read_ok[idx] = !rc;
+	}
+
+	sensor_unlock();
+
+	return 0;
+}
+
+static int bench_decode(bench_report_cb_t cb, void *user_data)
+{
+	const struct sensor_decoder_api *decoder;
+	struct sensor_read_config *cfg;
+	struct sensor_q31_data data;
+	struct rtio_iodev *iodev;
+	uint32_t cycles = 0;
+	uint32_t ops = 0;
+	uint32_t start;
+	uint32_t fit;
+	int rc;
+
+	rc = bench_sensors_read();
+	if (rc) {
+		return rc;
+	}
+
+	for (size_t idx = 0; idx < SENSOR_COUNT; ++idx) {
+		iodev = sensor_iodev_get(idx);
+		cfg = (struct sensor_read_config *)(iodev->data);
+
+		if (!bench_read_ok[idx]) {
+			continue;
+		}
+
+		rc = sensor_get_decoder(cfg->sensor, &decoder);
+		if (rc) {
+			LOG_WRN("%s: failed to get decoder (err %d)", cfg->sensor->name, rc);
+			continue;
+		}
+
+		start = k_cycle_get_32();
+		for (uint32_t it = 0; it < BENCH_ITERATIONS; ++it) {
+			for (size_t i = 0; i < cfg->count; ++i) {
+				fit = 0;
+				decoder->decode(bench_bufs[idx], cfg->channels[i], &fit, 1, &data);
+			}
+		}
+		cycles += k_cycle_get_32() - start;
+		ops += BENCH_ITERATIONS * cfg->count;
+	}
+
+	return bench_report(cb, user_data, "decode", SENSOR_COUNT, ops, cycles, 0,
+			    CONFIG_APP_BENCH_DECODE_CYCLES_MAX, 0);
+}
+
+static int bench_chan_type_str(bench_report_cb_t cb, void *user_data)
+{
+	uint32_t start;
+	uint32_t cycles;
+
+	start = k_cycle_get_32();
+	for (uint32_t it = 0; it < BENCH_ITERATIONS; ++it) {
+		for (int16_t chan = 0; chan < SENSOR_CHAN_ALL; ++chan) {
+			bench_sink ^= (uintptr_t)sensor_chan_type_str(chan);
+		}
+	}
+	cycles = k_cycle_get_32() - start;
+
+	return bench_report(cb, user_data, "chan_type_str", SENSOR_CHAN_ALL,
+			    BENCH_ITERATIONS * SENSOR_CHAN_ALL, cycles, 0, 0, 0);
+}
+
+/* Worst case payload: longest value representation in every reading. */
+static void bench_msg_fill(size_t count)
+{
+	const char *sensor;
+	const char *type;
+
+	bench_msg.count = count;
+	for (size_t i = 0; i < count; ++i) {
+		if (sensor_reading_chan_name(i, &sensor, &type)) {
+			sensor = "bench";
+			type = "unknown";
+		}
+
+		bench_msg.readings[i] = (struct sensor_reading){
+			.sensor = sensor,
+			.type = type,
+			.chan = i,
+			.value = INT32_MIN,
+			.shift = INT8_MIN,
+		};
+	}
+}
+
+static int bench_json_encode(bench_report_cb_t cb, void *user_data)
+{
+	uint64_t bytes;
+	uint32_t cycles;
+	uint32_t start;
+	int result = 0;
+	int rc;
+
+	for (size_t count = 1; count <= SENSOR_READINGS_MAX; ++count) {
+		bench_msg_fill(count);
+		bytes = 0;
+
+		start = k_cycle_get_32();
+		for (uint32_t it = 0; it < BENCH_ITERATIONS; ++it) {
+			rc = http_payload_encode(&bench_msg, bench_json, sizeof(bench_json));
+			if (rc) {
+				LOG_WRN("encoding %zu readings failed (err %d)", count, rc);
+				return rc;
+			}
+			bytes += strlen(bench_json);
+		}
+		cycles = k_cycle_get_32() - start;
+
+		rc = bench_report(cb, user_data, "json_encode", count, BENCH_ITERATIONS * count,
+				  cycles, bytes, CONFIG_APP_BENCH_ENCODE_CYCLES_MAX,
+				  CONFIG_APP_BENCH_ENCODE_BYTES_MAX);
+		if (rc && !result) {
+			result = rc;
+		}
+	}
+
+	return result;
+}
+
+static int bench_zbus(bench_report_cb_t cb, void *user_data)
+{
+	uint32_t cycles;
+	uint32_t start;
+	int rc;
+
+	bench_msg_fill(SENSOR_READINGS_MAX);
+
+	start = k_cycle_get_32();
+	for (uint32_t it = 0; it < BENCH_ITERATIONS; ++it) {
+		rc = zbus_chan_pub(&bench_chan, &bench_msg, K_FOREVER);
+		if (rc) {
+			LOG_WRN("zbus publish failed (err %d)", rc);
+			return rc;
+		}
+	}
+	cycles = k_cycle_get_32() - start;
+
+	return bench_report(cb, user_data, "zbus_handoff", SENSOR_READINGS_MAX, BENCH_ITERATIONS,
+			    cycles, (uint64_t)BENCH_ITERATIONS * sizeof(bench_msg), 0, 0);
+}
+
+int bench_hotpath(bench_report_cb_t cb, void *user_data)
+{
+	int (*const stages[])(bench_report_cb_t, void *) = {
+		bench_decode,
+		bench_chan_type_str,
+		bench_json_encode,
+		bench_zbus,
+	};
+	int result = 0;
+	int rc;
+
+	ARRAY_FOR_EACH(stages, idx) {
+		rc = stages[idx](cb, user_data);
+		if (rc && !result) {
+			result = rc;
+		}
+	}
+
+	return result;
+}
+
+static int bench_sample_cmp(const void *a, const void *b)
+{
+	uint32_t x = *(const uint32_t *)a;
+	uint32_t y = *(const uint32_t *)b;
+
+	return (x > y) - (x < y);
+}
+
+/* Sorts the first count cycle samples and reports their distribution. */
+static void bench_latency_report(bench_latency_cb_t cb, void *user_data, const char *name,
+				 const char *detail, uint32_t count, uint32_t errors,
+				 uint32_t bytes)
+{
+	struct bench_latency lat = {
+		.name = name,
+		.detail = detail,
+		.samples = count,
+		.errors = errors,
+		.bytes = bytes,
+	};
+	uint64_t sum = 0;
+
+	if (count) {
+		qsort(bench_samples, count, sizeof(bench_samples[0]), bench_sample_cmp);
+		for (uint32_t i = 0; i < count; ++i) {
+			sum += bench_samples[i];
+		}
+
+		lat.min_ns = k_cyc_to_ns_floor64(bench_samples[0]);
+		lat.avg_ns = k_cyc_to_ns_floor64(sum / count);
+		lat.p99_ns = k_cyc_to_ns_floor64(bench_samples[DIV_ROUND_UP(count * 99, 100) - 1]);
+	}
+
+	cb(&lat, user_data);
+}
+
+int bench_sensor(uint32_t count, bench_latency_cb_t cb, void *user_data)
+{
+	struct sensor_read_config *cfg;
+	struct rtio_iodev *iodev;
+	uint32_t samples;
+	uint32_t errors;
+	uint32_t start;
+	int rc;
+
+	count = MIN(count, BENCH_SAMPLES);
+
+	for (size_t idx = 0; idx < SENSOR_COUNT; ++idx) {
+		iodev = sensor_iodev_get(idx);
+		cfg = (struct sensor_read_config *)(iodev->data);
+		samples = 0;
+		errors = 0;
+
+		rc = sensor_lock(BENCH_SENSOR_LOCK_TIMEOUT);
+		if (rc) {
+			LOG_WRN("sensor thread busy (err %d)", rc);
+			return rc;
+		}
+
+		for (uint32_t it = 0; it < count; ++it) {
+			start = k_cycle_get_32();
+			rc = sensor_read(iodev, &bench_ctx, bench_bufs[idx], sizeof(bench_bufs[idx]));
+			if (rc) {
+				errors++;
+				continue;
+			}
+			bench_samples[samples++] = k_cycle_get_32() - start;
+		}
+
+		sensor_unlock();
+
+		bench_latency_report(cb, user_data, cfg->sensor->name, "read", samples, errors, 0);
+	}
+
+	return 0;
+}
+
+int bench_decode_chan(uint32_t count, bench_latency_cb_t cb, void *user_data)
+{
+	const struct sensor_decoder_api *decoder;
+	struct sensor_read_config *cfg;
+	struct sensor_q31_data data;
+	struct rtio_iodev *iodev;
+	uint32_t samples;
+	uint32_t errors;
+	uint32_t start;
+	uint32_t fit;
+	int rc;
+
+	count = MIN(count, BENCH_SAMPLES);
+
+	rc = bench_sensors_read();
+	if (rc) {
+		return rc;
+	}
+
+	for (size_t idx = 0; idx < SENSOR_COUNT; ++idx) {
+		iodev = sensor_iodev_get(idx);
+		cfg = (struct sensor_read_config *)(iodev->data);
+
+		if (!bench_read_ok[idx]) {
+			continue;
+		}
+
+		rc = sensor_get_decoder(cfg->sensor, &decoder);
+		if (rc) {
+			LOG_WRN("%s: failed to get decoder (err %d)", cfg->sensor->name, rc);
+			continue;
+		}
+
+		for (size_t i = 0; i < cfg->count; ++i) {
+			samples = 0;
+			errors = 0;
+
+			for (uint32_t it = 0; it < count; ++it) {
+				fit = 0;
+				start = k_cycle_get_32();
+				rc = decoder->decode(bench_bufs[idx], cfg->channels[i], &fit, 1, &data);
+				if (rc <= 0) {
+					errors++;
+					continue;
+				}
+				bench_samples[samples++] = k_cycle_get_32() - start;
+			}
+
+			bench_latency_report(cb, user_data, cfg->sensor->name,
+					     sensor_chan_type_str(cfg->channels[i].chan_type),
+					     samples, errors, 0);
+		}
+	}
+
+	return 0;
+}
+
+int bench_nvs(uint32_t count, bench_latency_cb_t cb, void *user_data)
+{
+	uint32_t data[BENCH_NVS_SIZE / sizeof(uint32_t)];
+	uint32_t samples = 0;
+	uint32_t errors = 0;
+	uint32_t start;
+	ssize_t rc;
+
+	count = MIN(count, MIN(BENCH_SAMPLES, BENCH_NVS_WRITES_MAX));
+
+	/* NVS skips writes of unchanged data, so every write carries a new pattern. */
+	for (uint32_t it = 0; it < count; ++it) {
+		for (size_t i = 0; i < ARRAY_SIZE(data); ++i) {
+			data[i] = k_cycle_get_32() ^ (it << 16 | i);
+		}
+
+		start = k_cycle_get_32();
+		rc = storage_bench_set(it % STORAGE_BENCH_SLOTS, data, sizeof(data));
+		if (rc != sizeof(data)) {
+			errors++;
+			continue;
+		}
+		bench_samples[samples++] = k_cycle_get_32() - start;
+	}
+	bench_latency_report(cb, user_data, "nvs", "write", samples, errors, sizeof(data));
+
+	samples = 0;
+	errors = 0;
+	for (uint32_t it = 0; it < count; ++it) {
+		start = k_cycle_get_32();
+		rc = storage_bench_get(it % STORAGE_BENCH_SLOTS, data, sizeof(data));
+		if (rc != sizeof(data)) {
+			errors++;
+			continue;
+		}
+		bench_samples[samples++] = k_cycle_get_32() - start;
+	}
+	bench_latency_report(cb, user_data, "nvs", "read", samples, errors, sizeof(data));
+
+	for (size_t slot = 0; slot < STORAGE_BENCH_SLOTS; ++slot) {
+		rc = storage_bench_delete(slot);
+		if (rc) {
+			LOG_WRN("failed to delete benchmark entry %zu (err %zd)", slot, rc);
+		}
+	}
+
+	return 0;
+}
+
+int bench_sha1(uint32_t kib, uint32_t count, bench_latency_cb_t cb, void *user_data)
+{
+	mbedtls_sha1_context ctx;
+	uint8_t digest[20];
+	uint32_t samples = 0;
+	uint32_t errors = 0;
+	uint32_t start;
+	int rc;
+
+	if (!kib || kib > BENCH_SHA1_KIB_MAX) {
+		return -EINVAL;
+	}
+
+	count = MIN(count, BENCH_SAMPLES);
+
+	for (size_t i = 0; i < sizeof(bench_sha1_buf); ++i) {
+		bench_sha1_buf[i] = i;
+	}
+
+	mbedtls_sha1_init(&ctx);
+
+	for (uint32_t it = 0; it < count; ++it) {
+		start = k_cycle_get_32();
+		rc = mbedtls_sha1_starts(&ctx);
+		for (uint32_t i = 0; i < kib && !rc; ++i) {
+			rc = mbedtls_sha1_update(&ctx, bench_sha1_buf, sizeof(bench_sha1_buf));
+		}
+		if (!rc) {
+			rc = mbedtls_sha1_finish(&ctx, digest);
+		}
+		if (rc) {
+			errors++;
+			continue;
+		}
+		bench_samples[samples++] = k_cycle_get_32() - start;
+	}
+
+	mbedtls_sha1_free(&ctx);
+
+	bench_latency_report(cb, user_data, "sha1", "hash", samples, errors,
+			     kib * sizeof(bench_sha1_buf));
+
+	return 0;
+}
+
+#ifdef CONFIG_APP_BENCH_BOOT
+static void bench_log_cb(const struct bench_result *res, void *user_data)
+{
+	LOG_INF("bench name=%s size=%u ops=%u cycles_per_op=%u ns_per_op=%u bytes_per_op=%u "
+		"result=%s",
+		res->name, res->size, res->ops, res->cycles_per_op, res->ns_per_op,
+		res->bytes_per_op, res->pass ? "PASS" : "FAIL");
+}
+
+static void bench_thrd(void *a1, void *a2, void *a3)
+{
+	int rc;
+
+	rc = bench_hotpath(bench_log_cb, NULL);
+
+	LOG_INF("bench done result=%s (err %d)", rc ? "FAIL" : "PASS", rc);
+}
+
+K_THREAD_DEFINE(bench_thrd_id, CONFIG_APP_BENCH_STACK_SIZE, bench_thrd, NULL, NULL, NULL,
+		K_LOWEST_APPLICATION_THREAD_PRIO, 0, 0);
+#endif /* CONFIG_APP_BENCH_BOOT */
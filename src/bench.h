@@ -0,0 +1,47 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* One measured stage; size is the stage specific problem size (0 when not applicable). */
+struct bench_result {
+	const char *name;
+	uint32_t size;
+	uint32_t ops;
+	uint32_t cycles_per_op;
+	uint32_t ns_per_op;
+	uint32_t bytes_per_op;
+	bool pass;
+};
+
+typedef void (*bench_report_cb_t)(const struct bench_result *res, void *user_data);
+
+/* Latency distribution of one repeated operation; bytes is the payload per sample (0 if none). */
+struct bench_latency {
+	const char *name;
+	const char *detail;
+	uint32_t samples;
+	uint32_t errors;
+	uint32_t bytes;
+	uint64_t min_ns;
+	uint64_t avg_ns;
+	uint64_t p99_ns;
+};
+
+typedef void (*bench_latency_cb_t)(const struct bench_latency *lat, void *user_data);
+
+/* Every NVS write wears the storage partition, so runs are short and use scratch entries. */
+#define BENCH_NVS_WRITES_MAX 32
+
+/* Samples are 32-bit cycle deltas, so a single hash has to stay well below their wrap. */
+#define BENCH_SHA1_KIB_MAX 1024
+
+int bench_hotpath(bench_report_cb_t cb, void *user_data);
+
+int bench_sensor(uint32_t count, bench_latency_cb_t cb, void *user_data);
+int bench_decode_chan(uint32_t count, bench_latency_cb_t cb, void *user_data);
+int bench_nvs(uint32_t count, bench_latency_cb_t cb, void *user_data);
+int bench_sha1(uint32_t kib, uint32_t count, bench_latency_cb_t cb, void *user_data);
+
+#endif // _BENCH_H
@@ -0,0 +1,300 @@
+#include "endpoint.h"
+#include "storage.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/socket.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_REGISTER(endpoint, CONFIG_APP_LOG_LEVEL);
+
+#define ENDPOINT_MAX        CONFIG_APP_SERVER_ENDPOINTS_MAX
+#define ENDPOINT_REPROBE_MS (CONFIG_APP_SERVER_REPROBE_INTERVAL * SEC_PER_MIN * MSEC_PER_SEC)
+
+/* Weight of a new connect latency sample in the moving average, as a power of two. */
+#define ENDPOINT_EWMA_SHIFT 2
+
+BUILD_ASSERT(ENDPOINT_MAX <= UINT8_MAX, "Too many endpoints");
+
+struct endpoint {
+	struct endpoint_cfg cfg;
+	uint32_t latency_ms;
+	uint32_t failures;
+	int64_t checked;
+	bool measured;
+	bool demoted;
+};
+
+static K_MUTEX_DEFINE(endpoint_lock);
+static struct endpoint endpoints[ENDPOINT_MAX];
+static size_t endpoint_count;
+
+/* Only the built-in default is loaded; the first added endpoint replaces it. */
+static bool using_default;
+
+static int endpoint_save()
+{
+	struct endpoint_cfg cfgs[ENDPOINT_MAX];
+	ssize_t rc;
+
+	for (size_t i = 0; i < endpoint_count; ++i) {
+		cfgs[i] = endpoints[i].cfg;
+	}
+
+	rc = storage_endpoints_set(cfgs, endpoint_count * sizeof(cfgs[0]));
+	if (rc < 0) {
+		LOG_ERR("failed to store endpoints (err %zd)", rc);
+		return rc;
+	}
+
+	return 0;
+}
+
+static int endpoint_parse(const char *ip, uint16_t port, struct endpoint_cfg *cfg)
+{
+	struct in_addr addr;
+
+	if (!port || zsock_inet_pton(AF_INET, ip, &addr) != 1) {
+		return -EINVAL;
+	}
+
+	memcpy(cfg->addr, &addr, sizeof(cfg->addr));
+	cfg->port = port;
+
+	return 0;
+}
+
+static void endpoint_default_set()
+{
+	endpoints[0] = (struct endpoint){0};
+	endpoint_parse(CONFIG_APP_SERVER_IP, CONFIG_APP_SERVER_PORT, &endpoints[0].cfg);
+	endpoint_count = 1;
+	using_default = true;
+}
+
+int endpoint_add(const char *ip, uint16_t port)
+{
+	struct endpoint_cfg cfg;
+	struct endpoint prev;
+	size_t idx;
+	int rc;
+
+	rc = endpoint_parse(ip, port, &cfg);
+	if (rc) {
+		return rc;
+	}
+
+	k_mutex_lock(&endpoint_lock, K_FOREVER);
+
+	idx = using_default ? 0 : endpoint_count;
+	if (idx == ENDPOINT_MAX) {
+		rc = -ENOSPC;
+		goto _unlock;
+	}
+
+	prev = endpoints[idx];
+	endpoints[idx] = (struct endpoint){.cfg = cfg};
+	endpoint_count = idx + 1;
+
+	rc = endpoint_save();
+	if (rc) {
+		endpoints[idx] = prev;
+		endpoint_count = using_default ? 1 : idx;
+		goto _unlock;
+	}
+
+	using_default = false;
+
+_unlock:
+	k_mutex_unlock(&endpoint_lock);
+	return rc;
+}
+
+/* Removing the last endpoint restores the built-in default. */
+int endpoint_del(size_t idx)
+{
+	struct endpoint prev;
+	int rc;
+
+	k_mutex_lock(&endpoint_lock, K_FOREVER);
+
+	if (idx >= endpoint_count) {
+		rc = -EINVAL;
+		goto _unlock;
+	}
+
+	prev = endpoints[idx];
+	memmove(&endpoints[idx], &endpoints[idx + 1],
+		(endpoint_count - idx - 1) * sizeof(endpoints[0]));
+	endpoint_count--;
+
+	rc = endpoint_save();
+	if (rc) {
+		memmove(&endpoints[idx + 1], &endpoints[idx],
+			(endpoint_count - idx) * sizeof(endpoints[0]));
+		endpoints[idx] = prev;
+		endpoint_count++;
+		goto _unlock;
+	}
+
+	if (!endpoint_count) {
+		endpoint_default_set();
+	}
+
+_unlock:
+	k_mutex_unlock(&endpoint_lock);
+	return rc;
+}
+
+int endpoint_info_get(size_t idx, struct endpoint_info *info)
+{
+	int rc = 0;
+
+	k_mutex_lock(&endpoint_lock, K_FOREVER);
+
+	if (idx < endpoint_count) {
+		*info = (struct endpoint_info){
+			.cfg = endpoints[idx].cfg,
+			.latency_ms = endpoints[idx].latency_ms,
+			.failures = endpoints[idx].failures,
+			.demoted = endpoints[idx].demoted,
+		};
+	} else {
+		rc = -ENOENT;
+	}
+
+	k_mutex_unlock(&endpoint_lock);
+	return rc;
+}
+
+/*
+ * Lower rank is tried first: endpoints due for a re-probe (never measured or not tried
+ * for a re-probe interval, demoted ones included), then healthy endpoints by connect
+ * latency, then demoted ones as a last resort.
+ */
+static uint64_t endpoint_rank(const struct endpoint *ep, int64_t now)
+{
+	if (!ep->measured || now - ep->checked >= ENDPOINT_REPROBE_MS) {
+		return 0;
+	}
+
+	return (ep->demoted ? BIT64(32) : 0) + ep->latency_ms + 1;
+}
+
+size_t endpoint_order(uint8_t *order, size_t len)
+{
+	int64_t now = k_uptime_get();
+	size_t count;
+	uint8_t tmp;
+
+	k_mutex_lock(&endpoint_lock, K_FOREVER);
+
+	count = MIN(endpoint_count, len);
+	for (size_t i = 0; i < count; ++i) {
+		order[i] = i;
+	}
+
+	for (size_t i = 1; i < count; ++i) {
+		for (size_t j = i; j > 0 && endpoint_rank(&endpoints[order[j]], now) <
+						    endpoint_rank(&endpoints[order[j - 1]], now);
+		     --j) {
+			tmp = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = tmp;
+		}
+	}
+
+	k_mutex_unlock(&endpoint_lock);
+	return count;
+}
+
+/* The list may have shrunk since endpoint_order() if an endpoint was deleted meanwhile. */
+int endpoint_addr_get(size_t idx, struct sockaddr_in *sa)
+{
+	int rc = 0;
+
+	k_mutex_lock(&endpoint_lock, K_FOREVER);
+
+	if (idx >= endpoint_count) {
+		rc = -ENOENT;
+		goto _unlock;
+	}
+
+	*sa = (struct sockaddr_in){
+		.sin_family = AF_INET,
+		.sin_port = htons(endpoints[idx].cfg.port),
+	};
+	memcpy(&sa->sin_addr, endpoints[idx].cfg.addr, sizeof(endpoints[idx].cfg.addr));
+
+_unlock:
+	k_mutex_unlock(&endpoint_lock);
+	return rc;
+}
+
+void endpoint_report(size_t idx, int64_t start, bool ok)
+{
+	uint32_t ms = k_ticks_to_ms_ceil32(k_uptime_ticks() - start);
+	struct endpoint *ep;
+
+	k_mutex_lock(&endpoint_lock, K_FOREVER);
+
+	if (idx >= endpoint_count) {
+		goto _unlock;
+	}
+	ep = &endpoints[idx];
+
+	ep->checked = k_uptime_get();
+	if (ok) {
+		if (ep->measured && !ep->demoted) {
+			ep->latency_ms += (ms >> ENDPOINT_EWMA_SHIFT) -
+					  (ep->latency_ms >> ENDPOINT_EWMA_SHIFT);
+		} else {
+			ep->latency_ms = ms;
+		}
+		ep->measured = true;
+		ep->demoted = false;
+	} else {
+		if (!ep->demoted) {
+			LOG_WRN("endpoint %zu demoted", idx);
+		}
+		ep->measured = true;
+		ep->demoted = true;
+		ep->failures++;
+	}
+
+_unlock:
+	k_mutex_unlock(&endpoint_lock);
+}
+
+static int endpoint_init()
+{
+	struct endpoint_cfg cfgs[ENDPOINT_MAX];
+	ssize_t rc;
+
+	rc = storage_endpoints_get(cfgs, sizeof(cfgs));
+	if (rc > 0 && rc % sizeof(cfgs[0]) == 0) {
+		endpoint_count = rc / sizeof(cfgs[0]);
+		for (size_t i = 0; i < endpoint_count; ++i) {
+			endpoints[i] = (struct endpoint){.cfg = cfgs[i]};
+		}
+	} else {
+		rc = endpoint_parse(CONFIG_APP_SERVER_IP, CONFIG_APP_SERVER_PORT, &endpoints[0].cfg);
+		if (rc) {
+			LOG_ERR("invalid ip address format: '%s'", CONFIG_APP_SERVER_IP);
+			return rc;
+		}
+		endpoint_count = 1;
+		using_default = true;
+	}
+
+	LOG_INF("%zu server endpoint(s)", endpoint_count);
+
+	return 0;
+}
+
+SYS_INIT(endpoint_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
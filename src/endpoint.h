@@ -0,0 +1,31 @@
+#ifndef _ENDPOINT_H
+#define _ENDPOINT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/net/net_ip.h>
+
+/* Persisted form of one server endpoint. */
+struct endpoint_cfg {
+	uint8_t addr[4];
+	uint16_t port;
+};
+
+struct endpoint_info {
+	struct endpoint_cfg cfg;
+	uint32_t latency_ms;
+	uint32_t failures;
+	bool demoted;
+};
+
+int endpoint_add(const char *ip, uint16_t port);
+int endpoint_del(size_t idx);
+int endpoint_info_get(size_t idx, struct endpoint_info *info);
+
+size_t endpoint_order(uint8_t *order, size_t len);
+int endpoint_addr_get(size_t idx, struct sockaddr_in *sa);
+void endpoint_report(size_t idx, int64_t start, bool ok);
+
+#endif // _ENDPOINT_H
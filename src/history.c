@@ -0,0 +1,709 @@
+#include "history.h"
+#include "sensor_map.h"
+#include "zbus.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <zephyr/drivers/flash.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/zbus/zbus.h>
+
+LOG_MODULE_REGISTER(history, CONFIG_APP_LOG_LEVEL);
+
+#define HISTORY_INIT_PRIORITY 99
+
+#define HISTORY_PARTITION    history_partition
+#define HISTORY_PARTITION_ID FIXED_PARTITION_ID(HISTORY_PARTITION)
+
+#define HISTORY_MAGIC      0xa5
+#define HISTORY_ERASED     0xff
+#define HISTORY_VALUES_MAX 3
+#define HISTORY_VARINT_MAX 5
+#define HISTORY_ALIGN_MAX  8
+
+#define HISTORY_CHAN_SIZE (2 + HISTORY_VALUES_MAX * HISTORY_VARINT_MAX)
+#define HISTORY_RECORD_MAX                                                                         \
+	ROUND_UP(sizeof(struct history_hdr) + SENSOR_READINGS_MAX * HISTORY_CHAN_SIZE,             \
+		 HISTORY_ALIGN_MAX)
+
+BUILD_ASSERT(SENSOR_READINGS_MAX < HISTORY_ERASED, "Too many channels for history records");
+
+/*
+ * A record is a header followed by one entry per channel: channel index, shift and
+ * zigzag varint deltas against the previous value of that channel in the same sector.
+ * Deltas restart at every sector boundary, so each sector decodes on its own and
+ * erasing the oldest one never breaks the rest of the ring.
+ */
+struct history_hdr {
+	uint8_t magic;
+	uint8_t crc;
+	uint16_t len;
+	uint32_t ts;
+} __packed;
+
+struct history_rec {
+	uint32_t ts;
+	size_t count;
+	uint8_t chan[SENSOR_READINGS_MAX];
+	int8_t shift[SENSOR_READINGS_MAX];
+	q31_t values[SENSOR_READINGS_MAX][HISTORY_VALUES_MAX];
+};
+
+struct history_tier_cfg {
+	uint32_t sectors;
+	uint32_t bucket;
+	uint32_t retention;
+	uint8_t values;
+};
+
+/* Previous value of every channel, the base of the next delta in the sector. */
+struct history_prev {
+	q31_t values[SENSOR_READINGS_MAX][HISTORY_VALUES_MAX];
+};
+
+struct history_ring {
+	off_t base;
+	uint32_t sector;
+	off_t wr;
+	struct history_prev prev;
+};
+
+struct history_agg {
+	uint32_t bucket;
+	uint32_t samples;
+	uint32_t n[SENSOR_READINGS_MAX];
+	int8_t shift[SENSOR_READINGS_MAX];
+	int64_t sum[SENSOR_READINGS_MAX];
+	q31_t min[SENSOR_READINGS_MAX];
+	q31_t max[SENSOR_READINGS_MAX];
+};
+
+struct history_query {
+	size_t chan;
+	uint32_t from;
+	uint32_t to;
+	uint8_t values;
+	history_cb_t cb;
+	void *user_data;
+};
+
+/* What the writer thread needs of a published sample. */
+struct history_sample {
+	uint32_t ts;
+	uint8_t count;
+	uint8_t chan[SENSOR_READINGS_MAX];
+	int8_t shift[SENSOR_READINGS_MAX];
+	q31_t value[SENSOR_READINGS_MAX];
+};
+
+typedef int (*history_rec_cb_t)(const struct history_rec *rec, void *user_data);
+
+static const struct history_tier_cfg tier_cfg[HISTORY_TIER_COUNT] = {
+	[HISTORY_TIER_RAW] = {
+		.sectors = CONFIG_APP_HISTORY_RAW_SECTORS,
+		.bucket = 0,
+		.retention = SEC_PER_HOUR,
+		.values = 1,
+	},
+	[HISTORY_TIER_MINUTE] = {
+		.sectors = CONFIG_APP_HISTORY_MINUTE_SECTORS,
+		.bucket = SEC_PER_MIN,
+		.retention = SEC_PER_DAY,
+		.values = HISTORY_VALUES_MAX,
+	},
+	[HISTORY_TIER_HOUR] = {
+		.sectors = CONFIG_APP_HISTORY_HOUR_SECTORS,
+		.bucket = SEC_PER_HOUR,
+		.retention = 30 * SEC_PER_DAY,
+		.values = HISTORY_VALUES_MAX,
+	},
+};
+
+static const struct flash_area *fa;
+static size_t sector_size;
+static size_t write_align;
+static uint32_t time_base;
+static bool ready;
+
+static struct history_ring rings[HISTORY_TIER_COUNT];
+static struct history_agg aggs[HISTORY_TIER_COUNT];
+static struct history_rec append_rec;
+static uint8_t append_buf[HISTORY_RECORD_MAX];
+
+static struct history_rec walk_rec;
+static uint8_t walk_buf[HISTORY_RECORD_MAX];
+static struct history_prev walk_prev;
+
+static K_MUTEX_DEFINE(history_lock);
+static K_MUTEX_DEFINE(query_lock);
+
+/* Flash erase and write take tens of ms, so they run on their own thread. */
+K_MSGQ_DEFINE(history_msgq, sizeof(struct history_sample), CONFIG_APP_HISTORY_QUEUE_SIZE, 4);
+
+static size_t varint_put(uint8_t *buf, int64_t delta)
+{
+	uint64_t zz = ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63);
+	size_t len = 0;
+
+	do {
+		buf[len] = zz & 0x7f;
+		zz >>= 7;
+		if (zz) {
+			buf[len] |= 0x80;
+		}
+		len++;
+	} while (zz);
+
+	return len;
+}
+
+static size_t varint_get(const uint8_t *buf, size_t len, int64_t *delta)
+{
+	uint64_t zz = 0;
+
+	for (size_t i = 0; i < MIN(len, HISTORY_VARINT_MAX); ++i) {
+		zz |= (uint64_t)(buf[i] & 0x7f) << (7 * i);
+		if (!(buf[i] & 0x80)) {
+			*delta = (int64_t)(zz >> 1) ^ -(int64_t)(zz & 1);
+			return i + 1;
+		}
+	}
+
+	return 0;
+}
+
+static q31_t q31_rescale(q31_t value, int8_t from, int8_t to)
+{
+	int64_t v = value;
+
+	if (to >= from) {
+		return (q31_t)(v >> MIN(to - from, 31));
+	}
+
+	v <<= MIN(from - to, 31);
+	return (q31_t)CLAMP(v, INT32_MIN, INT32_MAX);
+}
+
+static size_t rec_encode(const struct history_ring *ring, uint8_t values,
+			 const struct history_rec *rec)
+{
+	struct history_hdr *hdr = (struct history_hdr *)append_buf;
+	size_t len = sizeof(*hdr);
+	size_t padded;
+	uint8_t chan;
+
+	for (size_t i = 0; i < rec->count; ++i) {
+		chan = rec->chan[i];
+		append_buf[len++] = chan;
+		append_buf[len++] = (uint8_t)rec->shift[i];
+
+		for (uint8_t v = 0; v < values; ++v) {
+			len += varint_put(&append_buf[len],
+					  (int64_t)rec->values[i][v] - ring->prev.values[chan][v]);
+		}
+	}
+
+	padded = ROUND_UP(len, write_align);
+	memset(&append_buf[len], HISTORY_ERASED, padded - len);
+
+	hdr->magic = HISTORY_MAGIC;
+	hdr->len = padded;
+	hdr->ts = rec->ts;
+	hdr->crc = crc8_ccitt(0xff, &append_buf[offsetof(struct history_hdr, len)],
+			      padded - offsetof(struct history_hdr, len));
+
+	return padded;
+}
+
+static int rec_decode(const uint8_t *buf, size_t len, uint8_t values,
+		      struct history_prev *prev, struct history_rec *rec)
+{
+	const struct history_hdr *hdr = (const struct history_hdr *)buf;
+	size_t off = sizeof(*hdr);
+	int64_t delta;
+	uint8_t chan;
+	size_t n;
+
+	if (crc8_ccitt(0xff, &buf[offsetof(struct history_hdr, len)],
+		       len - offsetof(struct history_hdr, len)) != hdr->crc) {
+		return -EBADMSG;
+	}
+
+	rec->ts = hdr->ts;
+	rec->count = 0;
+
+	while (off + 2 <= len && buf[off] != HISTORY_ERASED) {
+		chan = buf[off++];
+		if (chan >= SENSOR_READINGS_MAX || rec->count >= SENSOR_READINGS_MAX) {
+			return -EBADMSG;
+		}
+
+		rec->chan[rec->count] = chan;
+		rec->shift[rec->count] = (int8_t)buf[off++];
+
+		for (uint8_t v = 0; v < values; ++v) {
+			n = varint_get(&buf[off], len - off, &delta);
+			if (!n) {
+				return -EBADMSG;
+			}
+			off += n;
+
+			prev->values[chan][v] = (q31_t)(prev->values[chan][v] + delta);
+			rec->values[rec->count][v] = prev->values[chan][v];
+		}
+
+		rec->count++;
+	}
+
+	return 0;
+}
+
+/*
+ * Deltas chain from record to record, so nothing after a corrupt record decodes correctly;
+ * the walk ends there and reports the sector as full, so no more records are appended to it.
+ */
+static int ring_walk(enum history_tier tier, uint32_t sector, struct history_prev *prev,
+		     off_t *end, history_rec_cb_t cb, void *user_data)
+{
+	const off_t sector_off = rings[tier].base + sector * sector_size;
+	struct history_hdr hdr;
+	off_t off = 0;
+	int rc = 0;
+
+	*prev = (struct history_prev){0};
+
+	while (off + sizeof(hdr) <= sector_size) {
+		rc = flash_area_read(fa, sector_off + off, &hdr, sizeof(hdr));
+		if (rc) {
+			break;
+		}
+
+		if (hdr.magic != HISTORY_MAGIC || hdr.len < sizeof(hdr) ||
+		    hdr.len > sizeof(walk_buf) || off + hdr.len > sector_size) {
+			break;
+		}
+
+		memcpy(walk_buf, &hdr, sizeof(hdr));
+		rc = flash_area_read(fa, sector_off + off + sizeof(hdr), &walk_buf[sizeof(hdr)],
+				     hdr.len - sizeof(hdr));
+		if (rc) {
+			break;
+		}
+		off += hdr.len;
+
+		if (rec_decode(walk_buf, hdr.len, tier_cfg[tier].values, prev, &walk_rec)) {
+			LOG_WRN("tier %d: corrupt record in sector %u, skipping the rest", tier,
+				sector);
+			off = sector_size;
+			break;
+		}
+
+		if (cb) {
+			rc = cb(&walk_rec, user_data);
+			if (rc) {
+				break;
+			}
+		}
+	}
+
+	if (end) {
+		*end = off;
+	}
+
+	return rc;
+}
+
+static int ring_advance(enum history_tier tier)
+{
+	struct history_ring *ring = &rings[tier];
+	uint32_t next = (ring->sector + 1) % tier_cfg[tier].sectors;
+	int rc;
+
+	rc = flash_area_erase(fa, ring->base + next * sector_size, sector_size);
+	if (rc) {
+		return rc;
+	}
+
+	ring->sector = next;
+	ring->wr = 0;
+	ring->prev = (struct history_prev){0};
+
+	return 0;
+}
+
+static int ring_append(enum history_tier tier, const struct history_rec *rec)
+{
+	struct history_ring *ring = &rings[tier];
+	const uint8_t values = tier_cfg[tier].values;
+	size_t len;
+	int rc;
+
+	if (!rec->count) {
+		return 0;
+	}
+
+	len = rec_encode(ring, values, rec);
+	if (ring->wr + len > sector_size) {
+		rc = ring_advance(tier);
+		if (rc) {
+			return rc;
+		}
+		len = rec_encode(ring, values, rec);
+	}
+
+	rc = flash_area_write(fa, ring->base + ring->sector * sector_size + ring->wr, append_buf,
+			      len);
+	if (rc) {
+		return rc;
+	}
+	ring->wr += len;
+
+	for (size_t i = 0; i < rec->count; ++i) {
+		memcpy(ring->prev.values[rec->chan[i]], rec->values[i], values * sizeof(q31_t));
+	}
+
+	return 0;
+}
+
+static void agg_add(struct history_agg *agg, uint8_t chan, q31_t value, int8_t shift)
+{
+	if (!agg->n[chan]) {
+		agg->shift[chan] = shift;
+		agg->sum[chan] = 0;
+		agg->min[chan] = INT32_MAX;
+		agg->max[chan] = INT32_MIN;
+	}
+
+	value = q31_rescale(value, shift, agg->shift[chan]);
+
+	agg->sum[chan] += value;
+	agg->min[chan] = MIN(agg->min[chan], value);
+	agg->max[chan] = MAX(agg->max[chan], value);
+	agg->n[chan]++;
+	agg->samples++;
+}
+
+static int agg_flush(enum history_tier tier)
+{
+	struct history_agg *agg = &aggs[tier];
+
+	append_rec.ts = agg->bucket;
+	append_rec.count = 0;
+
+	for (uint8_t chan = 0; chan < SENSOR_READINGS_MAX; ++chan) {
+		if (!agg->n[chan]) {
+			continue;
+		}
+
+		append_rec.chan[append_rec.count] = chan;
+		append_rec.shift[append_rec.count] = agg->shift[chan];
+		append_rec.values[append_rec.count][0] = agg->min[chan];
+		append_rec.values[append_rec.count][1] = (q31_t)(agg->sum[chan] / agg->n[chan]);
+		append_rec.values[append_rec.count][2] = agg->max[chan];
+		append_rec.count++;
+
+		agg->n[chan] = 0;
+	}
+	agg->samples = 0;
+
+	return ring_append(tier, &append_rec);
+}
+
+static void history_append(const struct history_sample *sample)
+{
+	const uint32_t ts = sample->ts;
+	struct history_agg *agg;
+	uint32_t bucket;
+	int rc;
+
+	k_mutex_lock(&history_lock, K_FOREVER);
+
+	append_rec.ts = ts;
+	append_rec.count = sample->count;
+	for (size_t i = 0; i < sample->count; ++i) {
+		append_rec.chan[i] = sample->chan[i];
+		append_rec.shift[i] = sample->shift[i];
+		append_rec.values[i][0] = sample->value[i];
+	}
+
+	rc = ring_append(HISTORY_TIER_RAW, &append_rec);
+	if (rc) {
+		LOG_WRN("failed to store raw sample (err %d)", rc);
+	}
+
+	for (enum history_tier tier = HISTORY_TIER_MINUTE; tier < HISTORY_TIER_COUNT; ++tier) {
+		agg = &aggs[tier];
+		bucket = ts - ts % tier_cfg[tier].bucket;
+
+		if (agg->samples && agg->bucket != bucket) {
+			rc = agg_flush(tier);
+			if (rc) {
+				LOG_WRN("tier %d: failed to store rollup (err %d)", tier, rc);
+			}
+		}
+		agg->bucket = bucket;
+
+		for (size_t i = 0; i < sample->count; ++i) {
+			agg_add(agg, sample->chan[i], sample->value[i], sample->shift[i]);
+		}
+	}
+
+	k_mutex_unlock(&history_lock);
+}
+
+/* Runs on the publishing sensor thread, so it only copies the sample out. */
+static void history_listener_cb(const struct zbus_channel *chan)
+{
+	const struct device_sensor_msg *msg = zbus_chan_const_msg(chan);
+	const struct sensor_reading *reading;
+	struct history_sample sample;
+
+	if (!ready) {
+		return;
+	}
+
+	sample.ts = time_base + (uint32_t)(msg->timestamp / MSEC_PER_SEC);
+	sample.count = 0;
+	for (size_t i = 0; i < msg->count; ++i) {
+		reading = &msg->readings[i];
+		if (reading->chan >= SENSOR_READINGS_MAX) {
+			continue;
+		}
+
+		sample.chan[sample.count] = reading->chan;
+		sample.shift[sample.count] = reading->shift;
+		sample.value[sample.count] = reading->value;
+		sample.count++;
+	}
+
+	if (k_msgq_put(&history_msgq, &sample, K_NO_WAIT)) {
+		LOG_WRN("history queue full, sample not stored");
+	}
+}
+
+ZBUS_LISTENER_DEFINE(history_listener, history_listener_cb);
+ZBUS_CHAN_ADD_OBS(environment_chan, history_listener, 0);
+
+static void history_thrd(void *a1, void *a2, void *a3)
+{
+	struct history_sample sample;
+
+	for (;;) {
+		k_msgq_get(&history_msgq, &sample, K_FOREVER);
+		history_append(&sample);
+	}
+}
+
+K_THREAD_DEFINE(history_thrd_id, CONFIG_APP_HISTORY_STACK_SIZE, history_thrd, NULL, NULL, NULL,
+		CONFIG_APP_HISTORY_THREAD_PRIORITY, 0, 0);
+
+uint32_t history_now()
+{
+	return time_base + (uint32_t)(k_uptime_get() / MSEC_PER_SEC);
+}
+
+uint32_t history_retention(enum history_tier tier)
+{
+	if (tier >= HISTORY_TIER_COUNT) {
+		return 0;
+	}
+	return tier_cfg[tier].retention;
+}
+
+static int query_cb(const struct history_rec *rec, void *user_data)
+{
+	const struct history_query *query = user_data;
+	const uint8_t avg = query->values > 1 ? 1 : 0;
+	const uint8_t max = query->values - 1;
+	struct history_point point;
+
+	if (rec->ts < query->from || rec->ts > query->to) {
+		return 0;
+	}
+
+	for (size_t i = 0; i < rec->count; ++i) {
+		if (rec->chan[i] != query->chan) {
+			continue;
+		}
+
+		point = (struct history_point){
+			.ts = rec->ts,
+			.shift = rec->shift[i],
+			.min = rec->values[i][0],
+			.avg = rec->values[i][avg],
+			.max = rec->values[i][max],
+		};
+		return query->cb(&point, query->user_data);
+	}
+
+	return 0;
+}
+
+int history_query(enum history_tier tier, size_t chan, uint32_t from, uint32_t to,
+		  history_cb_t cb, void *user_data)
+{
+	struct history_query query;
+	uint32_t sectors;
+	uint32_t newest;
+	int rc = 0;
+
+	if (!ready) {
+		return -ENODEV;
+	}
+
+	if (tier >= HISTORY_TIER_COUNT || chan >= SENSOR_READINGS_MAX || !cb) {
+		return -EINVAL;
+	}
+
+	query = (struct history_query){
+		.chan = chan,
+		.from = from,
+		.to = to,
+		.values = tier_cfg[tier].values,
+		.cb = cb,
+		.user_data = user_data,
+	};
+
+	k_mutex_lock(&query_lock, K_FOREVER);
+
+	k_mutex_lock(&history_lock, K_FOREVER);
+	newest = rings[tier].sector;
+	k_mutex_unlock(&history_lock);
+
+	/* Oldest sector first; records are streamed to the callback as they are decoded. */
+	sectors = tier_cfg[tier].sectors;
+	for (uint32_t i = 1; i <= sectors && !rc; ++i) {
+		rc = ring_walk(tier, (newest + i) % sectors, &walk_prev, NULL, query_cb, &query);
+	}
+
+	k_mutex_unlock(&query_lock);
+
+	return rc < 0 ? rc : 0;
+}
+
+static int ring_mount_cb(const struct history_rec *rec, void *user_data)
+{
+	uint32_t *max_ts = user_data;
+
+	*max_ts = MAX(*max_ts, rec->ts);
+	return 0;
+}
+
+static int ring_mount(enum history_tier tier, off_t base, uint32_t *max_ts)
+{
+	struct history_ring *ring = &rings[tier];
+	const uint32_t sectors = tier_cfg[tier].sectors;
+	struct history_hdr hdr;
+	uint32_t newest_ts = 0;
+	bool found = false;
+	uint8_t erased;
+	int rc;
+
+	ring->base = base;
+	ring->sector = 0;
+	ring->wr = 0;
+	ring->prev = (struct history_prev){0};
+
+	for (uint32_t sector = 0; sector < sectors; ++sector) {
+		rc = flash_area_read(fa, base + sector * sector_size, &hdr, sizeof(hdr));
+		if (rc) {
+			return rc;
+		}
+
+		if (hdr.magic == HISTORY_MAGIC && (!found || hdr.ts >= newest_ts)) {
+			found = true;
+			newest_ts = hdr.ts;
+			ring->sector = sector;
+		}
+	}
+
+	if (!found) {
+		LOG_INF("tier %d: no records, formatting", tier);
+		return flash_area_erase(fa, base, sectors * sector_size);
+	}
+
+	rc = ring_walk(tier, ring->sector, &ring->prev, &ring->wr, ring_mount_cb, max_ts);
+	if (rc) {
+		return rc;
+	}
+
+	/* Anything but erased flash past the last record means a torn write; skip the sector. */
+	if (ring->wr < sector_size) {
+		rc = flash_area_read(fa, base + ring->sector * sector_size + ring->wr, &erased,
+				     sizeof(erased));
+		if (rc) {
+			return rc;
+		}
+
+		if (erased != HISTORY_ERASED) {
+			ring->wr = sector_size;
+		}
+	}
+
+	return 0;
+}
+
+static int history_init()
+{
+	struct flash_pages_info info;
+	uint32_t total = 0;
+	uint32_t max_ts = 0;
+	off_t base = 0;
+	int rc;
+
+	rc = flash_area_open(HISTORY_PARTITION_ID, &fa);
+	if (rc) {
+		LOG_ERR("failed to open history partition (err %d)", rc);
+		return rc;
+	}
+
+	rc = flash_get_page_info_by_offs(flash_area_get_device(fa), fa->fa_off, &info);
+	if (rc) {
+		LOG_ERR("unable to get history page info (err %d)", rc);
+		return rc;
+	}
+	sector_size = info.size;
+	write_align = MAX(flash_area_align(fa), 1);
+
+	if (write_align > HISTORY_ALIGN_MAX || sector_size < HISTORY_RECORD_MAX) {
+		LOG_ERR("unsupported flash geometry (sector %zu, align %zu)", sector_size,
+			write_align);
+		return -ENOTSUP;
+	}
+
+	ARRAY_FOR_EACH(tier_cfg, tier) {
+		total += tier_cfg[tier].sectors;
+	}
+
+	if (total * sector_size > fa->fa_size) {
+		LOG_ERR("history partition too small (%u sectors needed)", total);
+		return -ENOSPC;
+	}
+
+	ARRAY_FOR_EACH(tier_cfg, tier) {
+		rc = ring_mount(tier, base, &max_ts);
+		if (rc) {
+			LOG_ERR("tier %zu: failed to mount (err %d)", tier, rc);
+			return rc;
+		}
+		base += tier_cfg[tier].sectors * sector_size;
+	}
+
+	/* Time only advances while powered, so continue from the newest stored record. */
+	time_base = max_ts ? max_ts + 1 : 0;
+	ready = true;
+
+	LOG_INF("mounted history storage (t=%u)", time_base);
+
+	return 0;
+}
+
+SYS_INIT(history_init, POST_KERNEL, HISTORY_INIT_PRIORITY);
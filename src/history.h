@@ -0,0 +1,33 @@
+#ifndef _HISTORY_H
+#define _HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/dsp/types.h>
+
+enum history_tier {
+	HISTORY_TIER_RAW,
+	HISTORY_TIER_MINUTE,
+	HISTORY_TIER_HOUR,
+	HISTORY_TIER_COUNT,
+};
+
+/* Raw samples report the same value as min, avg and max. */
+struct history_point {
+	uint32_t ts;
+	int8_t shift;
+	q31_t min;
+	q31_t avg;
+	q31_t max;
+};
+
+typedef int (*history_cb_t)(const struct history_point *point, void *user_data);
+
+uint32_t history_now();
+uint32_t history_retention(enum history_tier tier);
+
+int history_query(enum history_tier tier, size_t chan, uint32_t from, uint32_t to,
+		  history_cb_t cb, void *user_data);
+
+#endif // _HISTORY_H
@@ -1,5 +1,8 @@
+#include "http.h"
 #include "sensor_map.h"
+#include "stats.h"
 #include "timer.h"
+#include "trace.h"
 #include "net.h"
 #include "zbus.h"
 
@@ -7,6 +10,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
 
 #include <zephyr/init.h>
 #include <zephyr/zbus/zbus.h>
@@ -19,7 +23,8 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/hwinfo.h>
-#include <zephyr/data/json.h>
+#include <zephyr/random/random.h>
+#include <zephyr/sys/byteorder.h>
 #include <zephyr/sys/util.h>
 #include <zephyr/sys/util_macro.h>
 
@@ -36,9 +41,10 @@ LOG_MODULE_REGISTER(http, CONFIG_APP_LOG_LEVEL);
 #define APP_HTTP_POST_READING_URL "/devices/send_data"
 #define APP_HTTP_PROTOCOL         "HTTP/1.1"
 #define APP_HTTP_DEV_ID_HEADER    "X-SENSOR-ID"
+#define APP_HTTP_PRIORITY_HEADER  "X-SENSOR-PRIORITY"
+#define APP_HTTP_RETRY_AFTER      "Retry-After"
 
-#define ZEPHYR_USER_NODE DT_PATH(zephyr_user)
-#define SENSOR_COUNT     DT_PROP_LEN(ZEPHYR_USER_NODE, env_sensors)
+#define RETRY_AFTER_MAX_SEC (CONFIG_APP_NETWORK_RETRY_DELAY_MAX * SEC_PER_MIN)
 
 #define DT_NODE_FULL_NAME_BY_IDX(node_id, prop, idx)                                               \
 	DT_NODE_FULL_NAME(DT_PHANDLE_BY_IDX(node_id, prop, idx))
@@ -49,28 +55,37 @@ LOG_MODULE_REGISTER(http, CONFIG_APP_LOG_LEVEL);
 static char net_id[SHA1_HEX + 1] = {0};
 static char net_id_header[SHA1_HEX + sizeof(APP_HTTP_DEV_ID_HEADER) + 4] = {0};
 
+#ifdef CONFIG_APP_STATS_UPLINK
+#define APP_HTTP_HEALTH_HEADER "X-SENSOR-HEALTH"
+
+static char health_header[sizeof(APP_HTTP_HEALTH_HEADER) + CONFIG_APP_STATS_UPLINK_MAX_SIZE + 4];
+#endif
+
 static uint8_t recv_buf[128];
 static char json_buf[CONFIG_APP_MAX_JSON_PAYLOAD] = {0};
 
 static K_SEM_DEFINE(http_done, 0, 1);
 
 static bool authorized = false;
+static bool published = false;
+static bool boot_published = false;
+static uint32_t last_seq;
+
+/* Uploads are held off until then after the server asked to back off. */
+static int64_t retry_until;
+
+/* Header callbacks may be split across receive buffers, so matching is incremental. */
+static struct {
+	size_t field_len;
+	bool field_match;
+	bool in_value;
+	bool value_valid;
+	uint32_t seconds;
+} retry_after;
 
 const static char *sensors[] = {
 	DT_FOREACH_PROP_ELEM_SEP(ZEPHYR_USER_NODE, env_sensors, DT_NODE_FULL_NAME_BY_IDX, (,)) };
 
-static struct json_obj_descr sensor_reading_descr[] = {
-	JSON_OBJ_DESCR_PRIM(struct sensor_reading, sensor, JSON_TOK_STRING),
-	JSON_OBJ_DESCR_PRIM(struct sensor_reading, type, JSON_TOK_STRING),
-	JSON_OBJ_DESCR_PRIM(struct sensor_reading, value, JSON_TOK_NUMBER),
-	JSON_OBJ_DESCR_PRIM(struct sensor_reading, shift, JSON_TOK_NUMBER),
-};
-
-static struct json_obj_descr sensor_reading_arr[] = {
-	JSON_OBJ_DESCR_OBJ_ARRAY(struct device_sensor_msg, readings, SENSOR_READINGS_MAX, count,
-				 sensor_reading_descr, ARRAY_SIZE(sensor_reading_descr)),
-};
-
 static int net_id_init()
 {
 	int rc;
@@ -123,6 +138,9 @@ static int net_id_init()
 	snprintf(net_id_header, sizeof(net_id_header), "%s: %s\r\n", APP_HTTP_DEV_ID_HEADER,
 		 net_id);
 
+	/* Stable across reboots, so the device keeps its slot in the fleet's upload pattern. */
+	sensor_timer_phase_set(sys_get_be32(sha1_bytes));
+
 	LOG_INF("device id: %s", net_id);
 
 	return 0;
@@ -130,9 +148,110 @@ static int net_id_init()
 
 SYS_INIT(net_id_init, POST_KERNEL, NET_ID_INIT_PRIORITY);
 
-ZBUS_SUBSCRIBER_DEFINE(http_subscriber, 1);
+ZBUS_SUBSCRIBER_DEFINE(http_subscriber, 1 + IS_ENABLED(CONFIG_APP_ALERT));
 ZBUS_CHAN_ADD_OBS(environment_chan, http_subscriber, 0);
 
+#ifdef CONFIG_APP_ALERT
+/* Alerts are queued by a listener so none is lost while an upload is in flight. */
+K_MSGQ_DEFINE(alert_msgq, sizeof(struct sensor_alert), CONFIG_APP_ALERT_QUEUE_SIZE, 4);
+
+/* First delay between attempts to upload an alert, doubled on every retry. */
+#define ALERT_RETRY_DELAY_MS 1000
+
+static struct device_sensor_msg alert_msg;
+
+/* Failed uploads of the alert at the head of the queue. */
+static uint32_t alert_attempts;
+
+static void alert_listener_cb(const struct zbus_channel *chan)
+{
+	const struct sensor_alert *alert = zbus_chan_const_msg(chan);
+
+	if (k_msgq_put(&alert_msgq, alert, K_NO_WAIT)) {
+		LOG_WRN("alert queue full, alert dropped");
+	}
+}
+
+ZBUS_LISTENER_DEFINE(alert_listener, alert_listener_cb);
+ZBUS_CHAN_ADD_OBS(alert_chan, alert_listener, 0);
+ZBUS_CHAN_ADD_OBS(alert_chan, http_subscriber, 1);
+#endif /* CONFIG_APP_ALERT */
+
+static int retry_after_field_cb(struct http_parser *parser, const char *at, size_t length)
+{
+	const size_t name_len = sizeof(APP_HTTP_RETRY_AFTER) - 1;
+
+	if (retry_after.in_value || retry_after.field_len == 0) {
+		retry_after.in_value = false;
+		retry_after.field_len = 0;
+		retry_after.field_match = true;
+	}
+
+	if (retry_after.field_len + length > name_len ||
+	    strncasecmp(APP_HTTP_RETRY_AFTER + retry_after.field_len, at, length)) {
+		retry_after.field_match = false;
+	}
+	retry_after.field_len += length;
+
+	return 0;
+}
+
+/* Only the delay-seconds form is used; an HTTP-date falls back to the local backoff. */
+static int retry_after_value_cb(struct http_parser *parser, const char *at, size_t length)
+{
+	if (!retry_after.in_value) {
+		retry_after.in_value = true;
+		retry_after.value_valid = retry_after.field_match &&
+					  retry_after.field_len == sizeof(APP_HTTP_RETRY_AFTER) - 1;
+		/* Headers after Retry-After must not clear it. */
+		if (retry_after.value_valid) {
+			retry_after.seconds = 0;
+		}
+	}
+
+	for (size_t i = 0; retry_after.value_valid && i < length; ++i) {
+		if (at[i] == ' ' || at[i] == '\t') {
+			continue;
+		}
+		if (at[i] < '0' || at[i] > '9') {
+			retry_after.value_valid = false;
+			retry_after.seconds = 0;
+			break;
+		}
+		retry_after.seconds = MIN(retry_after.seconds * 10 + (at[i] - '0'),
+					  RETRY_AFTER_MAX_SEC);
+	}
+
+	return 0;
+}
+
+static const struct http_parser_settings retry_after_cb = {
+	.on_header_field = retry_after_field_cb,
+	.on_header_value = retry_after_value_cb,
+};
+
+static void retry_after_reset()
+{
+	memset(&retry_after, 0, sizeof(retry_after));
+}
+
+/*
+ * Full jitter: a uniformly random wait below the backoff cap, so nodes failing together
+ * do not retry together. A server Retry-After wins and is spread over one more interval.
+ */
+static uint32_t retry_delay_ms(int cap_min)
+{
+	uint32_t ms;
+
+	if (retry_after.seconds) {
+		ms = retry_after.seconds * MSEC_PER_SEC;
+		return ms + sys_rand32_get() % ms;
+	}
+
+	ms = MAX(cap_min, 1) * SEC_PER_MIN * MSEC_PER_SEC;
+	return sys_rand32_get() % ms;
+}
+
 static int authorize_response_cb(struct http_response *rsp, enum http_final_call final_data,
 				 void *user_data)
 {
@@ -150,6 +269,11 @@ static int authorize_response_cb(struct http_response *rsp, enum http_final_call
 		sensor_timer_stop();
 		LOG_INF("device not authorized");
 		break;
+	case HTTP_429_TOO_MANY_REQUESTS:
+	case HTTP_503_SERVICE_UNAVAILABLE:
+		LOG_WRN("server busy (status %d, retry after %u s)", rsp->http_status_code,
+			retry_after.seconds);
+		break;
 	default:
 		LOG_WRN("unexpected response status %d", rsp->http_status_code);
 		break;
@@ -164,7 +288,8 @@ static int authorize_device()
 	int rc;
 	int sock;
 	bool success;
-	int delay = CONFIG_APP_NETWORK_RETRY_DELAY;
+	int cap = CONFIG_APP_NETWORK_RETRY_DELAY;
+	uint32_t delay;
 
 	const static char *headers[] = {"Transfer-Encoding: chunked\r\n", NULL};
 
@@ -178,10 +303,13 @@ static int authorize_device()
 		.payload_len = strlen(net_id),
 		.recv_buf = recv_buf,
 		.recv_buf_len = sizeof(recv_buf),
+		.http_cb = &retry_after_cb,
 		.response = authorize_response_cb,
 	};
 
 	for (;;) {
+		retry_after_reset();
+
 		sock = server_connect();
 		if (sock < 0) {
 			goto _err_delay;
@@ -201,23 +329,33 @@ static int authorize_device()
 		}
 
 _err_delay:
-		LOG_WRN("next attempt in %d minute(s)", delay);
+		stats_inc(STATS_CNT_NET_RETRIES);
+		delay = retry_delay_ms(cap);
+		LOG_WRN("next attempt in %u s", delay / MSEC_PER_SEC);
 		server_disconnect(sock);
-		k_sleep(K_MINUTES(delay));
+		k_sleep(K_MSEC(delay));
 
-		delay = MIN(2 * delay, CONFIG_APP_NETWORK_RETRY_DELAY_MAX);
+		cap = MIN(2 * cap, CONFIG_APP_NETWORK_RETRY_DELAY_MAX);
 	}
 }
 
+/* user_data points to the sequence number of the pushed sample or alert. */
 static int publish_response_cb(struct http_response *rsp, enum http_final_call final_data,
 			       void *user_data)
 {
+	const uint32_t *seq = user_data;
+
+	ARG_UNUSED(seq);
+
 	if (final_data != HTTP_DATA_FINAL) {
 		return 0;
 	}
 
+	APP_TRACE(TRACE_HTTP_RESPONSE, *seq, rsp->http_status_code);
+
 	switch (rsp->http_status_code) {
 	case HTTP_200_OK:
+		published = true;
 		LOG_INF("data published");
 		break;
 	case HTTP_401_UNAUTHORIZED:
@@ -225,6 +363,12 @@ static int publish_response_cb(struct http_response *rsp, enum http_final_call f
 		authorized = false;
 		LOG_INF("device unauthorized");
 		break;
+	case HTTP_429_TOO_MANY_REQUESTS:
+	case HTTP_503_SERVICE_UNAVAILABLE:
+		retry_until = k_uptime_get() + retry_delay_ms(CONFIG_APP_NETWORK_RETRY_DELAY);
+		LOG_WRN("server busy (status %d, retry after %u s)", rsp->http_status_code,
+			retry_after.seconds);
+		break;
 	default:
 		LOG_WRN("unexpected response status %d", rsp->http_status_code);
 		break;
@@ -234,96 +378,241 @@ static int publish_response_cb(struct http_response *rsp, enum http_final_call f
 	return 0;
 }
 
-static int sensor_server_push()
+static int sensor_server_push(uint32_t seq, bool alert)
 {
 	int rc;
 	int sock;
-	bool success;
+	int64_t start;
 
-	const static char *headers[] = {"Transfer-Encoding: chunked\r\n", net_id_header, NULL};
+	const static char *headers[] = {
+		"Transfer-Encoding: chunked\r\n",
+		net_id_header,
+		IF_ENABLED(CONFIG_APP_STATS_UPLINK, (health_header,))
+		NULL,
+	};
+
+	const static char *alert_headers[] = {
+		"Transfer-Encoding: chunked\r\n",
+		net_id_header,
+		APP_HTTP_PRIORITY_HEADER ": alert\r\n",
+		NULL,
+	};
 
 	struct http_request req = {
 		.method = HTTP_POST,
 		.url = APP_HTTP_POST_READING_URL,
 		.protocol = APP_HTTP_PROTOCOL,
-		.header_fields = headers,
+		.header_fields = alert ? alert_headers : headers,
 		.content_type_value = "application/json",
 		.payload = json_buf,
 		.payload_len = strlen(json_buf),
 		.recv_buf = recv_buf,
 		.recv_buf_len = sizeof(recv_buf),
+		.http_cb = &retry_after_cb,
 		.response = publish_response_cb,
 	};
 
+#ifdef CONFIG_APP_STATS_UPLINK
+	char health[CONFIG_APP_STATS_UPLINK_MAX_SIZE];
+
+	rc = stats_health_format(health, sizeof(health));
+	snprintf(health_header, sizeof(health_header), "%s: %s\r\n", APP_HTTP_HEALTH_HEADER,
+		 rc < 0 ? "" : health);
+#endif
+
+	APP_TRACE(TRACE_CONNECT_BEGIN, seq, 0);
+
 	sock = server_connect();
+	APP_TRACE(TRACE_CONNECT, seq, sock);
 	if (sock < 0) {
 		return sock;
 	}
 
-	rc = http_client_req(sock, &req, NET_TIMEOUT_SEC, &success);
+	published = false;
+	retry_after_reset();
+	start = stats_start();
+
+	APP_TRACE(TRACE_HTTP_SEND, seq, req.payload_len);
+
+	rc = http_client_req(sock, &req, NET_TIMEOUT_SEC, &seq);
 	if (rc < 0) {
 		LOG_ERR("publish request failed (err %d)", rc);
 		goto _err_disc;
 	}
 
 	k_sem_take(&http_done, K_FOREVER);
+	stats_record_since(STATS_HIST_HTTP_RTT, start);
 
 _err_disc:
 	server_disconnect(sock);
-	return rc;
+
+	if (!published) {
+		return rc < 0 ? rc : -EIO;
+	}
+	return 0;
 }
 
+#ifdef CONFIG_APP_ALERT
+/*
+ * Sends every queued alert as its own upload, ahead of routine readings. An alert only
+ * leaves the queue once accepted or out of retries; after losing authorization it waits
+ * there for the next call.
+ */
+static void alert_publish()
+{
+	struct sensor_alert alert;
+	uint32_t delay = ALERT_RETRY_DELAY_MS;
+	int64_t latency;
+	int rc;
+
+	while (!k_msgq_peek(&alert_msgq, &alert)) {
+		alert_msg.readings[0] = alert.reading;
+		alert_msg.count = 1;
+		alert_msg.seq = alert.seq;
+		alert_msg.timestamp = alert.timestamp;
+
+		rc = http_payload_encode(&alert_msg, json_buf, ARRAY_SIZE(json_buf));
+		if (rc) {
+			LOG_ERR("failed to encode alert (err %d)", rc);
+			k_msgq_get(&alert_msgq, &alert, K_NO_WAIT);
+			continue;
+		}
+
+		rc = sensor_server_push(alert.seq, true);
+		if (rc) {
+			stats_inc(STATS_CNT_UPLOAD_FAILURES);
+			if (!authorized) {
+				return;
+			}
+			if (alert_attempts++ < CONFIG_APP_ALERT_RETRIES) {
+				LOG_WRN("alert upload failed, retry in %u ms", delay);
+				k_sleep(K_MSEC(delay));
+				delay *= 2;
+				continue;
+			}
+			LOG_ERR("alert dropped after %u attempts (err %d)", alert_attempts, rc);
+		} else {
+			latency = (k_uptime_get() - alert.timestamp) * USEC_PER_MSEC;
+			stats_record(STATS_HIST_ALERT_LATENCY, MIN(latency, UINT32_MAX));
+		}
+
+		k_msgq_get(&alert_msgq, &alert, K_NO_WAIT);
+		alert_attempts = 0;
+		delay = ALERT_RETRY_DELAY_MS;
+	}
+}
+#endif /* CONFIG_APP_ALERT */
+
 static int sensor_publish()
 {
-	const struct zbus_channel *chan;
 	struct device_sensor_msg msg;
+	int64_t start;
 	int rc;
 
-	rc = zbus_sub_wait(&http_subscriber, &chan, K_FOREVER);
+	rc = zbus_chan_read(&environment_chan, &msg, K_NO_WAIT);
 	if (rc) {
-		LOG_ERR("waiting for channel notification failed (err %d)", rc);
+		LOG_ERR("failed to read channel message (err %d)", rc);
 		return rc;
 	}
 
-	rc = zbus_chan_read(chan, &msg, K_NO_WAIT);
-	if (rc) {
-		LOG_ERR("failed to read channel message (err %d)", rc);
-		return rc;
+	/* Samples are overwritten in the channel while an upload is in flight. */
+	if (msg.seq > last_seq + 1) {
+		stats_add(STATS_CNT_SAMPLES_DROPPED, msg.seq - last_seq - 1);
 	}
+	last_seq = msg.seq;
 
 	rc = k_sem_take(msg.sem, K_SECONDS(1));
 	if (rc) {
 		LOG_ERR("failed to lock sensor buffer (err %d)", rc);
+		stats_inc(STATS_CNT_SAMPLES_DROPPED);
 		return rc;
 	}
 
-	rc = json_arr_encode_buf(sensor_reading_arr, &msg, json_buf, ARRAY_SIZE(json_buf));
+	start = stats_start();
+	rc = http_payload_encode(&msg, json_buf, ARRAY_SIZE(json_buf));
+	stats_record_since(STATS_HIST_JSON_ENCODE, start);
+	APP_TRACE(TRACE_ENCODE, msg.seq, strlen(json_buf));
 
 	k_sem_give(msg.sem);
 
 	if (rc) {
 		LOG_ERR("failed to encode json message (err %d)", rc);
+		stats_inc(STATS_CNT_SAMPLES_DROPPED);
 		return rc;
 	}
 
-	rc = sensor_server_push();
+	rc = sensor_server_push(msg.seq, false);
+	if (rc) {
+		stats_inc(STATS_CNT_UPLOAD_FAILURES);
+		stats_inc(STATS_CNT_SAMPLES_DROPPED);
+		return rc;
+	}
+
+	/* Time to first publish: for wake-publish-sleep nodes most energy goes here. */
+	if (!boot_published) {
+		int64_t now = k_uptime_get();
+
+		boot_published = true;
+		stats_add(STATS_CNT_FIRST_PUBLISH_MS, (uint32_t)MIN(now, UINT32_MAX));
+		LOG_INF("first publish %lld ms after boot (sample age %lld ms)", now,
+			now - msg.timestamp);
+	}
 
-	return rc;
+	stats_inc(STATS_CNT_UPLOADS);
+	return 0;
 }
 
 static void http_thrd(void *a1, void *a2, void *a3)
 {
+	const struct zbus_channel *chan;
+	bool sample_pending = false;
+	k_timeout_t timeout;
+	int64_t now;
+	int rc;
+
 	LOG_INF("network thread ready");
 
 	for (;;) {
 		if (!authorized) {
 			authorize_device();
-			k_sleep(K_SECONDS(1));
+#ifdef CONFIG_APP_ALERT
+			alert_publish();
+#endif
+		}
+
+		/*
+		 * Notifications keep draining during a server hold-off: alerts go out right away,
+		 * samples are coalesced into the latest one and uploaded once it is over.
+		 */
+		now = k_uptime_get();
+		if (retry_until > now) {
+			timeout = K_MSEC(retry_until - now);
+		} else if (sample_pending) {
+			sample_pending = false;
+			sensor_publish();
+			continue;
+		} else {
+			timeout = K_FOREVER;
+		}
+
+		rc = zbus_sub_wait(&http_subscriber, &chan, timeout);
+		if (rc == -EAGAIN) {
+			continue;
+		}
+		if (rc) {
+			LOG_ERR("waiting for channel notification failed (err %d)", rc);
+			continue;
+		}
+
+#ifdef CONFIG_APP_ALERT
+		alert_publish();
+		if (chan != &environment_chan) {
+			continue;
 		}
-		sensor_publish();
-		k_sleep(K_SECONDS(1));
+#endif
+		sample_pending = true;
 	}
 }
 
 K_THREAD_DEFINE(http_thrd_id, CONFIG_APP_NET_STACK_SIZE, http_thrd, NULL, NULL, NULL,
-		CONFIG_APP_NET_THREAD_PRIORITY, 0, 1500);
+		CONFIG_APP_NET_THREAD_PRIORITY, 0, 0);
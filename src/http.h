@@ -0,0 +1,10 @@
+#ifndef _HTTP_H
+#define _HTTP_H
+
+#include "zbus.h"
+
+#include <stddef.h>
+
+int http_payload_encode(const struct device_sensor_msg *msg, char *buf, size_t len);
+
+#endif // _HTTP_H
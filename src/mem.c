@@ -0,0 +1,127 @@
+#include "mem.h"
+#include "sensor.h"
+
+#include <stddef.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/buf.h>
+#include <zephyr/net/net_pkt.h>
+#include <zephyr/sys/mem_stats.h>
+#include <zephyr/sys/util.h>
+
+LOG_MODULE_REGISTER(mem, CONFIG_APP_LOG_LEVEL);
+
+#define MEM_POOL_COUNT 5
+
+struct mem_stack_ctx {
+	mem_stack_cb_t cb;
+	void *user_data;
+};
+
+static void mem_stack_cb(const struct k_thread *thread, void *user_data)
+{
+	struct mem_stack_ctx *ctx = user_data;
+	const char *name = k_thread_name_get((k_tid_t)thread);
+	size_t unused;
+
+	if (k_thread_stack_space_get(thread, &unused)) {
+		return;
+	}
+
+	ctx->cb(name && name[0] ? name : "unnamed", thread->stack_info.size, unused,
+		ctx->user_data);
+}
+
+void mem_stacks_foreach(mem_stack_cb_t cb, void *user_data)
+{
+	struct mem_stack_ctx ctx = {
+		.cb = cb,
+		.user_data = user_data,
+	};
+
+	k_thread_foreach_unlocked(mem_stack_cb, &ctx);
+}
+
+static void mem_slab_usage(struct mem_pool_usage *usage, const char *name,
+			   struct k_mem_slab *slab)
+{
+	*usage = (struct mem_pool_usage){
+		.name = name,
+		.used = k_mem_slab_num_used_get(slab),
+		.peak = k_mem_slab_max_used_get(slab),
+		.total = slab->info.num_blocks,
+	};
+}
+
+static void mem_buf_usage(struct mem_pool_usage *usage, const char *name,
+			  struct net_buf_pool *pool)
+{
+	*usage = (struct mem_pool_usage){
+		.name = name,
+		.used = pool->buf_count - atomic_get(&pool->avail_count),
+		.peak = pool->max_used,
+		.total = pool->buf_count,
+	};
+}
+
+size_t mem_pools_get(struct mem_pool_usage *pools, size_t count)
+{
+	struct mem_pool_usage all[MEM_POOL_COUNT];
+	struct sys_memory_stats rtio;
+	struct net_buf_pool *rx_data;
+	struct net_buf_pool *tx_data;
+	struct k_mem_slab *rx;
+	struct k_mem_slab *tx;
+
+	net_pkt_get_info(&rx, &tx, &rx_data, &tx_data);
+
+	mem_slab_usage(&all[0], "net_pkt_rx", rx);
+	mem_slab_usage(&all[1], "net_pkt_tx", tx);
+	mem_buf_usage(&all[2], "net_buf_rx", rx_data);
+	mem_buf_usage(&all[3], "net_buf_tx", tx_data);
+
+	all[4] = (struct mem_pool_usage){.name = "sensor_rtio (B)"};
+	if (!sensor_rtio_stats_get(&rtio)) {
+		all[4].used = rtio.allocated_bytes;
+		all[4].peak = rtio.max_allocated_bytes;
+		all[4].total = rtio.allocated_bytes + rtio.free_bytes;
+	}
+
+	count = MIN(count, ARRAY_SIZE(all));
+	for (size_t i = 0; i < count; ++i) {
+		pools[i] = all[i];
+	}
+
+	return count;
+}
+
+static void mem_report_stack_cb(const char *name, size_t size, size_t unused, void *user_data)
+{
+	LOG_INF("stack %s: %zu / %zu bytes used", name, size - unused, size);
+}
+
+static void mem_report_handler(struct k_work *work)
+{
+	struct mem_pool_usage pools[MEM_POOL_COUNT];
+	size_t count;
+
+	mem_stacks_foreach(mem_report_stack_cb, NULL);
+
+	count = mem_pools_get(pools, ARRAY_SIZE(pools));
+	for (size_t i = 0; i < count; ++i) {
+		LOG_INF("pool %s: %zu used, %zu peak, %zu total", pools[i].name, pools[i].used,
+			pools[i].peak, pools[i].total);
+	}
+}
+
+static K_WORK_DELAYABLE_DEFINE(mem_report_work, mem_report_handler);
+
+static int mem_report_init()
+{
+	k_work_schedule(&mem_report_work, K_SECONDS(CONFIG_APP_MEM_REPORT_DELAY));
+	return 0;
+}
+
+SYS_INIT(mem_report_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,18 @@
+#ifndef _MEM_H
+#define _MEM_H
+
+#include <stddef.h>
+
+struct mem_pool_usage {
+	const char *name;
+	size_t used;
+	size_t peak;
+	size_t total;
+};
+
+typedef void (*mem_stack_cb_t)(const char *name, size_t size, size_t unused, void *user_data);
+
+void mem_stacks_foreach(mem_stack_cb_t cb, void *user_data);
+size_t mem_pools_get(struct mem_pool_usage *pools, size_t count);
+
+#endif // _MEM_H
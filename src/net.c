@@ -1,10 +1,13 @@
+#include "endpoint.h"
 #include "net.h"
+#include "stats.h"
 #include "storage.h"
 #include "zephyr/net/net_event.h"
 
 #include <errno.h>
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
@@ -14,14 +17,25 @@
 #include <zephyr/net/net_ip.h>
 #include <zephyr/net/net_mgmt.h>
 #include <zephyr/net/socket.h>
+#include <zephyr/net/tls_credentials.h>
 #include <zephyr/net/wifi.h>
 #include <zephyr/net/wifi_mgmt.h>
 #include <zephyr/sys/clock.h>
+#include <zephyr/sys/util.h>
 #include <zephyr/toolchain.h>
 
 LOG_MODULE_REGISTER(net, CONFIG_APP_LOG_LEVEL);
 
+#ifdef CONFIG_APP_SERVER_TLS
+#define APP_TLS_SEC_TAG 1
+#define APP_SERVER_PROTO IPPROTO_TLS_1_2
+#else
+#define APP_SERVER_PROTO IPPROTO_TCP
+#endif
+
 static K_SEM_DEFINE(network_connected, 0, 1);
+static K_SEM_DEFINE(iface_ready, 0, 1);
+static bool network_up;
 
 static void l4_event_handler(uint64_t mgmt_event, struct net_if *iface, void *info,
 			     size_t info_length, void *user_data)
@@ -33,10 +47,12 @@ static void l4_event_handler(uint64_t mgmt_event, struct net_if *iface, void *in
 	switch (mgmt_event) {
 	case NET_EVENT_L4_CONNECTED:
 		LOG_INF("network connected");
+		network_up = true;
 		k_sem_give(&network_connected);
 		break;
 	case NET_EVENT_L4_DISCONNECTED:
 		LOG_INF("network disconnected");
+		network_up = false;
 		k_sem_take(&network_connected, K_NO_WAIT);
 		break;
 	}
@@ -46,10 +62,34 @@ static NET_MGMT_REGISTER_EVENT_HANDLER(net_connection_mgmt_handler,
 				       NET_EVENT_L4_CONNECTED | NET_EVENT_L4_DISCONNECTED,
 				       l4_event_handler, NULL);
 
+static void iface_event_handler(uint64_t mgmt_event, struct net_if *iface, void *info,
+				size_t info_length, void *user_data)
+{
+	ARG_UNUSED(iface);
+	ARG_UNUSED(info);
+	ARG_UNUSED(info_length);
+	ARG_UNUSED(user_data);
+
+	if (mgmt_event == NET_EVENT_IF_ADMIN_UP) {
+		k_sem_give(&iface_ready);
+	}
+}
+
+static NET_MGMT_REGISTER_EVENT_HANDLER(net_iface_mgmt_handler, NET_EVENT_IF_ADMIN_UP,
+				       iface_event_handler, NULL);
+
+/* With the local snapshot server the link stays up for pollers between uploads. */
 static void net_disconnect()
 {
 	struct net_if *iface = net_if_get_default();
 
+	if (IS_ENABLED(CONFIG_APP_SNAPSHOT_SERVER) && network_up) {
+		return;
+	}
+
+	/* The L4 disconnected event arrives later, don't let the next connect see a stale link. */
+	network_up = false;
+	k_sem_take(&network_connected, K_NO_WAIT);
 	net_mgmt(NET_REQUEST_WIFI_DISCONNECT, iface, NULL, 0);
 }
 
@@ -60,6 +100,12 @@ static int net_connect()
 	char pass[STORAGE_MAX_PASS_SIZE] = {0};
 	struct wifi_connect_req_params params = {0};
 	struct net_if *iface = net_if_get_default();
+	int64_t start;
+
+	/* Only the snapshot server keeps the link up between uploads. */
+	if (IS_ENABLED(CONFIG_APP_SNAPSHOT_SERVER) && network_up) {
+		return 0;
+	}
 
 	rc = storage_ssid_get(ssid, STORAGE_MAX_SSID_SIZE - 1);
 	if (rc < 0) {
@@ -82,8 +128,19 @@ static int net_connect()
 	params.band = WIFI_FREQ_BAND_2_4_GHZ;
 	params.mfp = WIFI_MFP_OPTIONAL;
 
+	/*
+	 * The Wi-Fi driver may still be bringing the interface up right after boot. Only the
+	 * admin state is awaited: the carrier stays off until the station has associated.
+	 */
+	if (!net_if_is_admin_up(iface) &&
+	    k_sem_take(&iface_ready, K_SECONDS(CONFIG_APP_NETWORK_TIMEOUT))) {
+		LOG_ERR("network interface not ready");
+		return -ENETDOWN;
+	}
+
 	LOG_DBG("Connecting to network %s", ssid);
 
+	start = stats_start();
 	rc = net_mgmt(NET_REQUEST_WIFI_CONNECT, iface, &params,
 		      sizeof(struct wifi_connect_req_params));
 	if (rc) {
@@ -94,50 +151,173 @@ static int net_connect()
 	rc = k_sem_take(&network_connected, K_SECONDS(CONFIG_APP_NETWORK_TIMEOUT));
 	if (rc) {
 		LOG_ERR("Failed to connect to network (err %d)", rc);
+		stats_inc(STATS_CNT_WIFI_FAILURES);
 		net_disconnect();
+		return rc;
 	}
 
+	stats_record_since(STATS_HIST_WIFI_CONNECT, start);
+
 	return rc;
 }
 
-int server_connect()
+#ifdef CONFIG_APP_SERVER_TLS
+#ifdef CONFIG_APP_SERVER_TLS_CERT
+static const unsigned char ca_cert[] = {
+#include "app_ca_cert.der.inc"
+};
+#else
+static uint8_t psk[sizeof(CONFIG_APP_SERVER_TLS_PSK_KEY) / 2];
+#endif
+
+static int tls_credentials_init()
 {
 	int rc;
-	int sock;
-	struct sockaddr_in sa;
 
-	rc = net_connect();
+#ifdef CONFIG_APP_SERVER_TLS_CERT
+	rc = tls_credential_add(APP_TLS_SEC_TAG, TLS_CREDENTIAL_CA_CERTIFICATE, ca_cert,
+				sizeof(ca_cert));
 	if (rc) {
-		goto _err_net_disconnect;
+		LOG_ERR("failed to add CA certificate (err %d)", rc);
+		return rc;
+	}
+#else
+	size_t len;
+
+	len = hex2bin(CONFIG_APP_SERVER_TLS_PSK_KEY, strlen(CONFIG_APP_SERVER_TLS_PSK_KEY), psk,
+		      sizeof(psk));
+	if (!len) {
+		LOG_ERR("invalid pre-shared key");
+		return -EINVAL;
+	}
+
+	rc = tls_credential_add(APP_TLS_SEC_TAG, TLS_CREDENTIAL_PSK, psk, len);
+	if (rc) {
+		LOG_ERR("failed to add pre-shared key (err %d)", rc);
+		return rc;
+	}
+
+	rc = tls_credential_add(APP_TLS_SEC_TAG, TLS_CREDENTIAL_PSK_ID, CONFIG_APP_SERVER_TLS_PSK_ID,
+				strlen(CONFIG_APP_SERVER_TLS_PSK_ID));
+	if (rc) {
+		LOG_ERR("failed to add pre-shared key identity (err %d)", rc);
+		return rc;
+	}
+#endif
+
+	return 0;
+}
+
+SYS_INIT(tls_credentials_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+static int tls_setup(int sock)
+{
+	const sec_tag_t sec_tags[] = {APP_TLS_SEC_TAG};
+	int rc;
+
+	rc = zsock_setsockopt(sock, SOL_TLS, TLS_SEC_TAG_LIST, sec_tags, sizeof(sec_tags));
+	if (rc < 0) {
+		LOG_ERR("failed to set TLS credentials (err %d)", -errno);
+		return -errno;
+	}
+
+#ifdef CONFIG_APP_SERVER_TLS_CERT
+	rc = zsock_setsockopt(sock, SOL_TLS, TLS_HOSTNAME, CONFIG_APP_SERVER_TLS_HOSTNAME,
+			      strlen(CONFIG_APP_SERVER_TLS_HOSTNAME));
+	if (rc < 0) {
+		LOG_ERR("failed to set TLS hostname (err %d)", -errno);
+		return -errno;
 	}
-	k_sleep(K_SECONDS(1));
+#endif
 
-	sa = (struct sockaddr_in){
-		.sin_family = AF_INET,
-		.sin_port = htons(CONFIG_APP_SERVER_PORT),
-	};
+#ifdef CONFIG_APP_SERVER_TLS_SESSION_CACHE
+	/* Sessions are cached per peer address, so they survive the socket being closed. */
+	int cache = TLS_SESSION_CACHE_ENABLED;
 
-	rc = zsock_inet_pton(AF_INET, CONFIG_APP_SERVER_IP, &sa.sin_addr);
+	rc = zsock_setsockopt(sock, SOL_TLS, TLS_SESSION_CACHE, &cache, sizeof(cache));
 	if (rc < 0) {
-		LOG_ERR("invalid ip address format: '%s'", CONFIG_APP_SERVER_IP);
+		LOG_ERR("failed to enable TLS session cache (err %d)", -errno);
+		return -errno;
+	}
+#endif
+
+	return 0;
+}
+#endif /* CONFIG_APP_SERVER_TLS */
+
+static int endpoint_connect(size_t idx)
+{
+	int rc;
+	int sock;
+	int64_t start;
+	struct sockaddr_in sa;
+
+	rc = endpoint_addr_get(idx, &sa);
+	if (rc) {
+		LOG_DBG("server %zu gone (err %d)", idx, rc);
+		return rc;
 	}
 
-	rc = zsock_socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+	rc = zsock_socket(AF_INET, SOCK_STREAM, APP_SERVER_PROTO);
 	if (rc < 0) {
-		LOG_ERR("failed to create socket (err %d)", rc);
-		goto _err_net_disconnect;
+		LOG_ERR("failed to create socket (err %d)", -errno);
+		return -errno;
 	}
 	sock = rc;
 
+#ifdef CONFIG_APP_SERVER_TLS
+	rc = tls_setup(sock);
+	if (rc) {
+		zsock_close(sock);
+		return rc;
+	}
+#endif
+
+	/* For TLS sockets connect also runs the handshake. */
+	start = stats_start();
 	rc = zsock_connect(sock, (struct sockaddr *)&sa, sizeof(sa));
+	if (rc) {
+		rc = -errno;
+	}
+	endpoint_report(idx, start, rc == 0);
 	if (rc == 0) {
-		LOG_DBG("server connected");
+		stats_record_since(IS_ENABLED(CONFIG_APP_SERVER_TLS) ? STATS_HIST_TLS_CONNECT
+								      : STATS_HIST_TCP_CONNECT,
+				   start);
+		LOG_DBG("server %zu connected", idx);
 		return sock;
 	}
 
 	zsock_close(sock);
+	LOG_WRN("server %zu connection failed (err %d)", idx, rc);
+
+	return rc;
+}
+
+/* Tries the endpoints in preference order, failing over after the socket connect timeout. */
+int server_connect()
+{
+	uint8_t order[CONFIG_APP_SERVER_ENDPOINTS_MAX];
+	size_t count;
+	int rc;
+
+	rc = net_connect();
+	if (rc) {
+		goto _err_net_disconnect;
+	}
+
+	rc = -ENOENT;
+	count = endpoint_order(order, ARRAY_SIZE(order));
+	for (size_t i = 0; i < count; ++i) {
+		rc = endpoint_connect(order[i]);
+		if (rc >= 0) {
+			return rc;
+		}
+	}
+
+	stats_inc(STATS_CNT_SERVER_FAILURES);
+	LOG_ERR("server connection failed (err %d)", rc);
 
-	LOG_ERR("server connection failed (err %d)", -errno);
 _err_net_disconnect:
 	net_disconnect();
 	return rc;
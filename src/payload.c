@@ -0,0 +1,25 @@
+#include "http.h"
+#include "sensor_map.h"
+#include "zbus.h"
+
+#include <stddef.h>
+
+#include <zephyr/data/json.h>
+#include <zephyr/sys/util.h>
+
+static struct json_obj_descr sensor_reading_descr[] = {
+	JSON_OBJ_DESCR_PRIM(struct sensor_reading, sensor, JSON_TOK_STRING),
+	JSON_OBJ_DESCR_PRIM(struct sensor_reading, type, JSON_TOK_STRING),
+	JSON_OBJ_DESCR_PRIM(struct sensor_reading, value, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_PRIM(struct sensor_reading, shift, JSON_TOK_NUMBER),
+};
+
+static struct json_obj_descr sensor_reading_arr[] = {
+	JSON_OBJ_DESCR_OBJ_ARRAY(struct device_sensor_msg, readings, SENSOR_READINGS_MAX, count,
+				 sensor_reading_descr, ARRAY_SIZE(sensor_reading_descr)),
+};
+
+int http_payload_encode(const struct device_sensor_msg *msg, char *buf, size_t len)
+{
+	return json_arr_encode_buf(sensor_reading_arr, msg, buf, len);
+}
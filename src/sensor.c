@@ -1,6 +1,13 @@
+#include "alert.h"
+#include "sensor.h"
+#include "stats.h"
+#include "timer.h"
+#include "trace.h"
 #include "zbus.h"
 #include "sensor_map.h"
 
+#include <errno.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 #include <zephyr/device.h>
@@ -10,15 +17,14 @@
 #include <zephyr/drivers/sensor_data_types.h>
 #include <zephyr/logging/log.h>
 #include <zephyr/rtio/rtio.h>
+#include <zephyr/sys/mem_blocks.h>
+#include <zephyr/sys/mem_stats.h>
 #include <zephyr/sys/util.h>
 #include <zephyr/sys/util_macro.h>
 #include <zephyr/zbus/zbus.h>
 
 LOG_MODULE_REGISTER(sensor, CONFIG_APP_LOG_LEVEL);
 
-#define ZEPHYR_USER_NODE DT_PATH(zephyr_user)
-#define SENSOR_COUNT     DT_PROP_LEN(ZEPHYR_USER_NODE, env_sensors)
-
 #define SENSOR_IODEV_SYM(idx)      CONCAT(_sens_iodev_, idx)
 #define SENSOR_IODEV_PTR(idx, ...) &SENSOR_IODEV_SYM(idx)
 
@@ -33,12 +39,60 @@ LOG_MODULE_REGISTER(sensor, CONFIG_APP_LOG_LEVEL);
 
 DT_FOREACH_PROP_ELEM_SEP(ZEPHYR_USER_NODE, env_sensors, SENSOR_IODEV_DEFINE, (;));
 
-RTIO_DEFINE_WITH_MEMPOOL(sensor_ctx, SENSOR_COUNT, SENSOR_COUNT, SENSOR_COUNT, 64, sizeof(void *));
+RTIO_DEFINE_WITH_MEMPOOL(sensor_ctx, SENSOR_COUNT, SENSOR_COUNT, SENSOR_COUNT,
+			 SENSOR_BUF_BLOCK_SIZE, sizeof(void *));
 
 static struct rtio_iodev *iodevs[SENSOR_COUNT] = {LISTIFY(SENSOR_COUNT, SENSOR_IODEV_PTR, (,))};
 
+/* Bounds how long a round can be held up by the channel lock or a full subscriber queue. */
+#define SENSOR_PUB_TIMEOUT K_MSEC(10)
+
+#define SENSOR_POLICY_SKIP     0
+#define SENSOR_POLICY_CATCH_UP 1
+
+/* clang-format off */
+#define SENSOR_POLICY(idx, ...)										\
+	COND_CODE_1(DT_NODE_HAS_PROP(ZEPHYR_USER_NODE, env_sensors_policy),			\
+		(DT_PROP_BY_IDX(ZEPHYR_USER_NODE, env_sensors_policy, idx)),			\
+		(COND_CODE_1(CONFIG_APP_SENSOR_CATCH_UP,					\
+			(SENSOR_POLICY_CATCH_UP), (SENSOR_POLICY_SKIP))))
+/* clang-format on */
+
+/* What to do with ticks missed under load: replay them (catch up) or drop them (skip). */
+static const uint8_t sensor_policy[SENSOR_COUNT] = {LISTIFY(SENSOR_COUNT, SENSOR_POLICY, (,))};
+
+/* Index of each sensor's first channel in the flattened devicetree channel list. */
+static uint8_t chan_base[SENSOR_COUNT];
+
+/* Sensors already reported for reads larger than one mempool block. */
+static bool buf_oversize[SENSOR_COUNT];
+
+#define SENSOR_NODE(idx) DT_PHANDLE_BY_IDX(ZEPHYR_USER_NODE, env_sensors, idx)
+
+/* Sensors directly under the root node (GPIO driven) don't share their bus with anything. */
+#define SENSOR_BUS_ORD(idx, ...)                                                                   \
+	(DT_SAME_NODE(DT_PARENT(SENSOR_NODE(idx)), DT_ROOT) ? UINT16_MAX - (idx)                   \
+							    : DT_DEP_ORD(DT_PARENT(SENSOR_NODE(idx))))
+#define SENSOR_BUS_NAME(idx, ...) DT_NODE_FULL_NAME(DT_PARENT(SENSOR_NODE(idx)))
+
+static const uint16_t sensor_bus_ord[SENSOR_COUNT] = {LISTIFY(SENSOR_COUNT, SENSOR_BUS_ORD, (,))};
+static const char *const sensor_bus_name[SENSOR_COUNT] = {
+	LISTIFY(SENSOR_COUNT, SENSOR_BUS_NAME, (,))};
+
+/*
+ * Reads without a native driver submit run on the RTIO work queue, one sensor per pool thread.
+ * Submitting round-robin across buses starts one read on every bus before a second one is
+ * queued behind a busy bus, so slow conversions on one bus overlap transfers on the others.
+ */
+static uint8_t sensor_bus[SENSOR_COUNT];
+static uint8_t submit_order[SENSOR_COUNT];
+static size_t bus_count;
+
 K_SEM_DEFINE(reading_sem, 1, 1);
 
+/* Held for a whole sampling round, so benchmarks can use the iodevs without racing it. */
+static K_MUTEX_DEFINE(round_lock);
+
 static struct device_sensor_msg zbus_msg = {
 	.readings = {},
 	.count = 0,
@@ -58,58 +112,110 @@ ZBUS_CHAN_DEFINE(environment_chan,	/* Name */
 );
 /* clang-format on */
 
-static const char *chan_type_str(int16_t chan)
+const char *sensor_name(size_t idx)
+{
+	if (idx >= SENSOR_COUNT) {
+		return NULL;
+	}
+	return ((struct sensor_read_config *)(iodevs[idx]->data))->sensor->name;
+}
+
+struct rtio_iodev *sensor_iodev_get(size_t idx)
+{
+	if (idx >= SENSOR_COUNT) {
+		return NULL;
+	}
+	return iodevs[idx];
+}
+
+/* Pool usage is only tracked with CONFIG_SYS_MEM_BLOCKS_RUNTIME_STATS (see APP_MEM_REPORT). */
+int sensor_rtio_stats_get(struct sys_memory_stats *stats)
+{
+#ifdef CONFIG_SYS_MEM_BLOCKS_RUNTIME_STATS
+	return sys_mem_blocks_runtime_stats_get(sensor_ctx.block_pool, stats);
+#else
+	ARG_UNUSED(stats);
+	return -ENOTSUP;
+#endif
+}
+
+int sensor_lock(k_timeout_t timeout)
+{
+	return k_mutex_lock(&round_lock, timeout);
+}
+
+void sensor_unlock()
+{
+	k_mutex_unlock(&round_lock);
+}
+
+int sensor_reading_chan_name(size_t chan, const char **sensor, const char **type)
+{
+	struct sensor_read_config *cfg;
+
+	ARRAY_FOR_EACH(iodevs, idx) {
+		cfg = (struct sensor_read_config *)(iodevs[idx]->data);
+
+		if (chan < cfg->count) {
+			*sensor = cfg->sensor->name;
+			*type = sensor_chan_type_str(cfg->channels[chan].chan_type);
+			return 0;
+		}
+		chan -= cfg->count;
+	}
+
+	return -EINVAL;
+}
+
+static void sensor_bus_init()
 {
-	switch (chan) {
-	case SENSOR_CHAN_DIE_TEMP:
-	case SENSOR_CHAN_AMBIENT_TEMP:
-		return "temp";
-	case SENSOR_CHAN_PRESS:
-		return "press";
-	case SENSOR_CHAN_PROX:
-		return "prox";
-	case SENSOR_CHAN_HUMIDITY:
-		return "humid";
-	case SENSOR_CHAN_LIGHT:
-	case SENSOR_CHAN_AMBIENT_LIGHT:
-		return "light";
-	case SENSOR_CHAN_IR:
-		return "ir";
-	case SENSOR_CHAN_RED:
-		return "red";
-	case SENSOR_CHAN_GREEN:
-		return "green";
-	case SENSOR_CHAN_BLUE:
-		return "blue";
-	case SENSOR_CHAN_ALTITUDE:
-		return "alt";
-	case SENSOR_CHAN_PM_1_0:
-		return "pm1.0";
-	case SENSOR_CHAN_PM_2_5:
-		return "pm2.5";
-	case SENSOR_CHAN_PM_10:
-		return "pm10";
-	case SENSOR_CHAN_DISTANCE:
-		return "dist";
-	case SENSOR_CHAN_CO2:
-		return "co2";
-	case SENSOR_CHAN_O2:
-		return "o2";
-	case SENSOR_CHAN_GAS_RES:
-		return "gas_res";
-	case SENSOR_CHAN_VOC:
-		return "voc";
-	case SENSOR_CHAN_VOLTAGE:
-		return "volt";
-	default:
-		return "unknown";
+	size_t count = 0;
+	size_t seen;
+
+	ARRAY_FOR_EACH(iodevs, idx) {
+		sensor_bus[idx] = bus_count;
+		for (size_t prev = 0; prev < idx; ++prev) {
+			if (sensor_bus_ord[prev] == sensor_bus_ord[idx]) {
+				sensor_bus[idx] = sensor_bus[prev];
+				break;
+			}
+		}
+		if (sensor_bus[idx] == bus_count) {
+			bus_count++;
+		}
+
+		LOG_DBG("%s: bus %u (%s)",
+			((struct sensor_read_config *)(iodevs[idx]->data))->sensor->name,
+			sensor_bus[idx], sensor_bus_name[idx]);
+	}
+
+	for (size_t rank = 0; count < SENSOR_COUNT; ++rank) {
+		for (size_t bus = 0; bus < bus_count; ++bus) {
+			seen = 0;
+			ARRAY_FOR_EACH(iodevs, idx) {
+				if (sensor_bus[idx] == bus && seen++ == rank) {
+					submit_order[count++] = idx;
+					break;
+				}
+			}
+		}
+	}
+
+	if (bus_count > CONFIG_RTIO_WORKQ_THREADS_POOL) {
+		LOG_WRN("%zu sensor buses but %d RTIO work queue threads, reads will serialize",
+			bus_count, CONFIG_RTIO_WORKQ_THREADS_POOL);
 	}
 }
 
 static void sensor_init()
 {
 	const struct device *dev;
+	uint8_t base = 0;
+
 	ARRAY_FOR_EACH(iodevs, idx) {
+		chan_base[idx] = base;
+		base += ((struct sensor_read_config *)(iodevs[idx]->data))->count;
+
 		dev = ((struct sensor_read_config *)(iodevs[idx]->data))->sensor;
 
 		if (!device_is_ready(dev)) {
@@ -118,107 +224,229 @@ static void sensor_init()
 		}
 	}
 
+	sensor_bus_init();
+
 	LOG_INF("sensor thread ready");
 }
 
-static void sensor_loop()
+static int sensor_round(const struct sensor_tick *tick, bool catch_up_only)
 {
-	const struct sensor_decoder_api *decoder;
-	const struct zbus_channel *chan;
-	const char *chan_type;
-	struct sensor_q31_data data;
+	struct sensor_reading *readings;
 	struct sensor_read_config *cfg;
 	struct rtio_cqe *cqe;
+	size_t submitted = 0;
+	size_t iodev_idx;
+	size_t idx;
+	int64_t start;
 	uint8_t *buf;
 	uint32_t buf_len;
-	uint32_t fit;
+	int64_t read_at;
+	int result;
 	int rc;
 
-	for (;;) {
-		rc = zbus_sub_wait(&env_subscriber, &chan, K_FOREVER);
+	start = stats_start();
+	read_at = k_uptime_get();
+
+	ARRAY_FOR_EACH(submit_order, n) {
+		idx = submit_order[n];
+
+		if (catch_up_only && sensor_policy[idx] != SENSOR_POLICY_CATCH_UP) {
+			continue;
+		}
+
+		cfg = (struct sensor_read_config *)(iodevs[idx]->data);
+
+		rc = sensor_read_async_mempool(iodevs[idx], &sensor_ctx, &iodevs[idx]);
 		if (rc) {
-			LOG_WRN("waiting for channel notification failed (err %d)", rc);
+			LOG_WRN("%s: failed to init sensor read (err %d)", cfg->sensor->name, rc);
 			continue;
 		}
+		submitted++;
+
+		APP_TRACE(TRACE_SUBMIT, tick->seq, idx);
+	}
 
-		ARRAY_FOR_EACH(iodevs, idx) {
-			cfg = (struct sensor_read_config *)(iodevs[idx]->data);
+	if (!submitted) {
+		return 0;
+	}
 
-			rc = sensor_read_async_mempool(iodevs[idx], &sensor_ctx, iodevs[idx]);
-			if (rc) {
-				LOG_WRN("%s: failed to init sensor read (err %d)",
-					cfg->sensor->name, rc);
-				continue;
-			}
+	rc = k_sem_take(&reading_sem, K_FOREVER);
+	if (rc) {
+		LOG_ERR("failed to lock readings message (err %d)", rc);
+		return rc;
+	}
+
+	/* Replays are stamped with when they were actually read, never back-dated to the tick. */
+	zbus_msg.count = 0;
+	zbus_msg.seq = tick->seq;
+	zbus_msg.timestamp = read_at;
+	zbus_msg.late = catch_up_only || read_at - k_ticks_to_ms_floor64(tick->deadline) >
+						  CONFIG_APP_SENSOR_LATE_THRESHOLD_MS;
+
+	for (size_t n = 0; n < submitted; ++n) {
+		cqe = rtio_cqe_consume_block(&sensor_ctx);
+		iodev_idx = (struct rtio_iodev **)cqe->userdata - iodevs;
+		cfg = (struct sensor_read_config *)(iodevs[iodev_idx]->data);
+		result = cqe->result;
+
+		APP_TRACE(TRACE_CQE, tick->seq, iodev_idx);
+
+		if (result) {
+			rtio_cqe_release(&sensor_ctx, cqe);
+			LOG_WRN("%s: async read failed (err %d)", cfg->sensor->name, result);
+			continue;
 		}
 
-		rc = k_sem_take(&reading_sem, K_FOREVER);
+		stats_record_since(STATS_HIST_SENSOR_READ + iodev_idx, start);
+
+		rc = rtio_cqe_get_mempool_buffer(&sensor_ctx, cqe, &buf, &buf_len);
+		rtio_cqe_release(&sensor_ctx, cqe);
 		if (rc) {
-			LOG_ERR("failed to lock readings message (err %d)", rc);
-			return;
-		}
-
-		zbus_msg.count = 0;
-		ARRAY_FOR_EACH(iodevs, _) {
-			cqe = rtio_cqe_consume_block(&sensor_ctx);
-			if (cqe->result) {
-				LOG_WRN("%s: async read failed (err %d)", cfg->sensor->name,
-					cqe->result);
-				rtio_cqe_release(&sensor_ctx, cqe);
-				continue;
-			}
+			LOG_WRN("%s: failed to get memory buffer (err %d)", cfg->sensor->name, rc);
+			continue;
+		}
 
-			cfg = (struct sensor_read_config *)((struct rtio_iodev *)cqe->userdata)
-				      ->data;
-			rtio_cqe_release(&sensor_ctx, cqe);
+		/* Concurrent reads share SENSOR_COUNT blocks, so a multi-block read can starve others. */
+		if (buf_len > SENSOR_BUF_BLOCK_SIZE && !buf_oversize[iodev_idx]) {
+			buf_oversize[iodev_idx] = true;
+			LOG_WRN("%s: read needs %u bytes, pool blocks are %u, raise "
+				"CONFIG_APP_SENSOR_BUF_BLOCK_SIZE",
+				cfg->sensor->name, buf_len, (uint32_t)SENSOR_BUF_BLOCK_SIZE);
+		}
 
-			rc = rtio_cqe_get_mempool_buffer(&sensor_ctx, cqe, &buf, &buf_len);
-			if (rc) {
-				LOG_WRN("%s: failed to get memory buffer (err %d)",
-					cfg->sensor->name, rc);
-				continue;
-			}
+		readings = &zbus_msg.readings[zbus_msg.count];
+		rc = sensor_decode(cfg, buf, chan_base[iodev_idx], readings);
+		rtio_release_buffer(&sensor_ctx, buf, buf_len);
+		if (rc < 0) {
+			LOG_WRN("%s: failed to get decoder (err %d)", cfg->sensor->name, rc);
+			continue;
+		}
+		zbus_msg.count += rc;
 
-			rc = sensor_get_decoder(cfg->sensor, &decoder);
-			if (rc) {
-				LOG_WRN("%s: failed to get decoder (err %d)", cfg->sensor->name,
-					rc);
-				continue;
-			}
+		for (size_t i = 0; i < rc; ++i) {
+			LOG_DBG("%s: %s = %s%d.%02d", readings[i].sensor, readings[i].type,
+				PRIq_arg(readings[i].value, 2, readings[i].shift));
 
-			for (size_t i = 0; i < cfg->count; ++i) {
-				fit = 0;
-				decoder->decode(buf, cfg->channels[i], &fit, 1, &data);
-				chan_type = chan_type_str(cfg->channels[i].chan_type);
+#ifdef CONFIG_APP_ALERT
+			alert_check(&readings[i], tick->seq, zbus_msg.timestamp);
+#endif
+		}
+
+		APP_TRACE(TRACE_DECODE, tick->seq, iodev_idx);
+	}
 
-				LOG_DBG("%s: %s = %s%d.%02d", cfg->sensor->name, chan_type,
-					PRIq_arg(data.readings[0].value, 2, data.shift));
+	stats_record_since(STATS_HIST_SENSOR_ROUND, start);
 
-				zbus_msg.readings[zbus_msg.count++] = (struct sensor_reading){
-					.sensor = cfg->sensor->name,
-					.type = chan_type,
-					.value = data.readings[0].value,
-					.shift = data.shift,
-				};
-			}
+	/*
+	 * Never wait on a busy uploader while holding reading_sem: the channel keeps only the
+	 * latest sample, and one that never reaches it shows up as a sequence gap, which the
+	 * uploader counts as dropped.
+	 */
+	rc = zbus_chan_pub(&environment_chan, &zbus_msg, SENSOR_PUB_TIMEOUT);
+	if (rc) {
+		LOG_WRN("failed to publish environment data (err %d)", rc);
+	}
+
+	APP_TRACE(TRACE_PUBLISH, tick->seq, zbus_msg.count);
+
+	k_sem_give(&reading_sem);
+
+	return rc;
+}
+
+#ifdef CONFIG_APP_CPU_STATS
+/*
+ * CPU time of the sensor thread for one tick, and of all non-idle threads over one sampling
+ * period. The latter includes deferred log processing and uploads.
+ */
+static void sensor_cpu_record(uint64_t thread_start, uint64_t *total_cycles)
+{
+	k_thread_runtime_stats_t rt;
+
+	if (thread_start && !k_thread_runtime_stats_get(k_current_get(), &rt)) {
+		stats_record(STATS_HIST_SENSOR_CPU,
+			     k_cyc_to_us_floor64(rt.execution_cycles - thread_start));
+	}
+
+	if (!k_thread_runtime_stats_all_get(&rt)) {
+		if (*total_cycles) {
+			stats_record(STATS_HIST_CYCLE_CPU,
+				     k_cyc_to_us_floor64(rt.total_cycles - *total_cycles));
+		}
+		*total_cycles = rt.total_cycles;
+	}
+}
+
+static uint64_t sensor_cpu_start()
+{
+	k_thread_runtime_stats_t rt;
+
+	return k_thread_runtime_stats_get(k_current_get(), &rt) ? 0 : rt.execution_cycles;
+}
+#endif /* CONFIG_APP_CPU_STATS */
+
+static void sensor_loop()
+{
+	const struct zbus_channel *chan;
+	struct sensor_tick missed_tick;
+	struct sensor_tick tick;
+	uint32_t catch_up;
+	int rc;
+#ifdef CONFIG_APP_CPU_STATS
+	uint64_t thread_cycles;
+	uint64_t total_cycles = 0;
+#endif
 
-			rtio_release_buffer(&sensor_ctx, buf, buf_len);
+	for (;;) {
+		rc = zbus_sub_wait(&env_subscriber, &chan, K_FOREVER);
+		if (rc) {
+			LOG_WRN("waiting for channel notification failed (err %d)", rc);
+			continue;
 		}
 
-		rc = zbus_chan_pub(&environment_chan, &zbus_msg, K_FOREVER);
+		/* Always handle the latest tick; anything skipped in between shows as missed. */
+		rc = zbus_chan_read(chan, &tick, K_MSEC(100));
 		if (rc) {
-			LOG_WRN("failed to publish environment data (err %d)", rc);
+			LOG_WRN("failed to read timer tick (err %d)", rc);
+			continue;
 		}
 
-		k_sem_give(&reading_sem);
+#ifdef CONFIG_APP_CPU_STATS
+		thread_cycles = sensor_cpu_start();
+#endif
+
+		k_mutex_lock(&round_lock, K_FOREVER);
+
+		catch_up = MIN(sensor_sched_begin(&tick), CONFIG_APP_SENSOR_CATCH_UP_MAX);
+
+		/* Missed ticks are replayed oldest first as late reads, only for catch-up sensors. */
+		for (uint32_t i = catch_up; i > 0; --i) {
+			missed_tick = (struct sensor_tick){
+				.seq = tick.seq - i,
+				.deadline = tick.deadline - i * tick.period,
+				.period = tick.period,
+			};
+			sensor_round(&missed_tick, true);
+		}
+
+		sensor_round(&tick, false);
+
+		k_mutex_unlock(&round_lock);
+
+#ifdef CONFIG_APP_CPU_STATS
+		sensor_cpu_record(thread_cycles, &total_cycles);
+#endif
 	}
 }
 
 static void sensor_thrd(void *a1, void *a2, void *a3)
 {
 	sensor_init();
+
+	/* The first round overlaps the Wi-Fi connect and is uploaded once authorized. */
+	sensor_timer_start();
 	sensor_loop();
 }
 
 K_THREAD_DEFINE(sensor_thrd_id, CONFIG_APP_SENSOR_STACK_SIZE, sensor_thrd, NULL, NULL, NULL,
-		CONFIG_APP_SENSOR_THREAD_PRIORITY, 0, 1000);
+		CONFIG_APP_SENSOR_THREAD_PRIORITY, 0, 0);
@@ -0,0 +1,28 @@
+#ifndef _SENSOR_H
+#define _SENSOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+
+struct rtio_iodev;
+struct sensor_read_config;
+struct sensor_reading;
+struct sys_memory_stats;
+
+const char *sensor_name(size_t idx);
+const char *sensor_chan_type_str(int16_t chan);
+struct rtio_iodev *sensor_iodev_get(size_t idx);
+int sensor_rtio_stats_get(struct sys_memory_stats *stats);
+int sensor_reading_chan_name(size_t chan, const char **sensor, const char **type);
+
+/* Decodes every configured channel of one read; returns the number of readings filled. */
+int sensor_decode(const struct sensor_read_config *cfg, const uint8_t *buf, uint8_t chan_base,
+		  struct sensor_reading *readings);
+
+/* Keeps the sensor thread from starting a sampling round until unlocked. */
+int sensor_lock(k_timeout_t timeout);
+void sensor_unlock();
+
+#endif // _SENSOR_H
@@ -0,0 +1,86 @@
+#include "sensor.h"
+#include "zbus.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/drivers/sensor_data_types.h>
+
+const char *sensor_chan_type_str(int16_t chan)
+{
+	switch (chan) {
+	case SENSOR_CHAN_DIE_TEMP:
+	case SENSOR_CHAN_AMBIENT_TEMP:
+		return "temp";
+	case SENSOR_CHAN_PRESS:
+		return "press";
+	case SENSOR_CHAN_PROX:
+		return "prox";
+	case SENSOR_CHAN_HUMIDITY:
+		return "humid";
+	case SENSOR_CHAN_LIGHT:
+	case SENSOR_CHAN_AMBIENT_LIGHT:
+		return "light";
+	case SENSOR_CHAN_IR:
+		return "ir";
+	case SENSOR_CHAN_RED:
+		return "red";
+	case SENSOR_CHAN_GREEN:
+		return "green";
+	case SENSOR_CHAN_BLUE:
+		return "blue";
+	case SENSOR_CHAN_ALTITUDE:
+		return "alt";
+	case SENSOR_CHAN_PM_1_0:
+		return "pm1.0";
+	case SENSOR_CHAN_PM_2_5:
+		return "pm2.5";
+	case SENSOR_CHAN_PM_10:
+		return "pm10";
+	case SENSOR_CHAN_DISTANCE:
+		return "dist";
+	case SENSOR_CHAN_CO2:
+		return "co2";
+	case SENSOR_CHAN_O2:
+		return "o2";
+	case SENSOR_CHAN_GAS_RES:
+		return "gas_res";
+	case SENSOR_CHAN_VOC:
+		return "voc";
+	case SENSOR_CHAN_VOLTAGE:
+		return "volt";
+	default:
+		return "unknown";
+	}
+}
+
+/* Shared by the sensor thread and the hot path tests, so both measure the same code. */
+int sensor_decode(const struct sensor_read_config *cfg, const uint8_t *buf, uint8_t chan_base,
+		  struct sensor_reading *readings)
+{
+	const struct sensor_decoder_api *decoder;
+	struct sensor_q31_data data;
+	uint32_t fit;
+	int rc;
+
+	rc = sensor_get_decoder(cfg->sensor, &decoder);
+	if (rc) {
+		return rc;
+	}
+
+	for (size_t i = 0; i < cfg->count; ++i) {
+		fit = 0;
+		decoder->decode(buf, cfg->channels[i], &fit, 1, &data);
+
+		readings[i] = (struct sensor_reading){
+			.sensor = cfg->sensor->name,
+			.type = sensor_chan_type_str(cfg->channels[i].chan_type),
+			.chan = chan_base + i,
+			.value = data.readings[0].value,
+			.shift = data.shift,
+		};
+	}
+
+	return cfg->count;
+}
@@ -1,16 +1,21 @@
 #ifndef _SENSOR_MAP_H
 #define _SENSOR_MAP_H
 
+#include <stdint.h>
+
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/sensor.h>
+#include <zephyr/dsp/types.h>
 #include <zephyr/sys/util.h>
 #include <zephyr/sys/util_macro.h>
 
 #define ZEPHYR_USER_NODE DT_PATH(zephyr_user)
+#define SENSOR_COUNT     DT_PROP_LEN(ZEPHYR_USER_NODE, env_sensors)
 
 #define SENSOR_CHAN_BY_COMPAT(phandle, compat, ...)                                                \
 	COND_CODE_1(DT_NODE_HAS_COMPAT(phandle, compat), (__VA_ARGS__), ())
 
+/* vnd,env-sensor is the fake sensor of the tests/hotpath suite. */
 #define SENSOR_CHAN_MAP(phandle)                                                                   \
 	SENSOR_CHAN_BY_COMPAT(phandle, rohm_bh1750, {SENSOR_CHAN_LIGHT, 0})                        \
 	SENSOR_CHAN_BY_COMPAT(phandle, sensirion_sht4x, {SENSOR_CHAN_AMBIENT_TEMP, 0},             \
@@ -32,7 +37,9 @@
 			      {SENSOR_CHAN_RED, 0}, {SENSOR_CHAN_GREEN, 0},                        \
 			      {SENSOR_CHAN_GAS_BLUE, 0}, {SENSOR_CHAN_PROX, 0})                    \
 	SENSOR_CHAN_BY_COMPAT(phandle, vishay_vcnl4040, {SENSOR_CHAN_PROX, 0},                     \
-			      {SENSOR_CHAN_LIGHT, 0})
+			      {SENSOR_CHAN_LIGHT, 0})                                              \
+	SENSOR_CHAN_BY_COMPAT(phandle, vnd_env_sensor, {SENSOR_CHAN_AMBIENT_TEMP, 0},              \
+			      {SENSOR_CHAN_HUMIDITY, 0}, {SENSOR_CHAN_PRESS, 0})
 
 #define SENSOR_CHAN_COUNT(node_id, prop, idx)                                                      \
 	ARRAY_SIZE(((struct sensor_chan_spec[]){                                                   \
@@ -41,4 +48,27 @@
 #define SENSOR_READINGS_MAX                                                                        \
 	DT_FOREACH_PROP_ELEM_SEP(ZEPHYR_USER_NODE, env_sensors, SENSOR_CHAN_COUNT, (+))
 
+/*
+ * Encoded read buffer of a sensor using the generic (fetch/get) submit path: a header
+ * followed by a channel spec and a q31 sample per channel.
+ */
+#define SENSOR_BUF_SIZE(node_id, prop, idx)                                                        \
+	(sizeof(struct sensor_data_generic_header) +                                               \
+	 SENSOR_CHAN_COUNT(node_id, prop, idx) * (sizeof(struct sensor_chan_spec) + sizeof(q31_t)))
+
+#define SENSOR_BUF_MEMBER(node_id, prop, idx)                                                      \
+	uint8_t CONCAT(_buf_, idx)[SENSOR_BUF_SIZE(node_id, prop, idx)];
+
+union sensor_buf_max {
+	DT_FOREACH_PROP_ELEM(ZEPHYR_USER_NODE, env_sensors, SENSOR_BUF_MEMBER)
+};
+
+/*
+ * RTIO mempool block, large enough for one generic read of the biggest configured sensor.
+ * Drivers with a native submit use their own, possibly larger, encoding; the sensor thread
+ * warns when such a read spans several blocks and CONFIG_APP_SENSOR_BUF_BLOCK_SIZE raises it.
+ */
+#define SENSOR_BUF_BLOCK_SIZE                                                                      \
+	NHPOT(MAX(sizeof(union sensor_buf_max), CONFIG_APP_SENSOR_BUF_BLOCK_SIZE))
+
 #endif // _SENSOR_MAP_H
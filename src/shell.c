@@ -1,10 +1,21 @@
+#include "alert.h"
+#include "bench.h"
+#include "endpoint.h"
+#include "history.h"
+#include "mem.h"
+#include "sensor.h"
+#include "stats.h"
 #include "storage.h"
+#include "timer.h"
 
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
+#include <zephyr/drivers/sensor_data_types.h>
 #include <zephyr/shell/shell.h>
 #include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
 
 static int cmd_set_ssid(const struct shell *shell, size_t argc, char *argv[])
 {
@@ -48,5 +59,487 @@ static int cmd_set_pass(const struct shell *shell, size_t argc, char *argv[])
 	return 0;
 }
 
+static int cmd_server_list(const struct shell *shell, size_t argc, char *argv[])
+{
+	struct endpoint_info info;
+
+	for (size_t idx = 0; !endpoint_info_get(idx, &info); ++idx) {
+		shell_print(shell, "%zu: %u.%u.%u.%u:%u latency %u ms failures %u%s", idx,
+			    info.cfg.addr[0], info.cfg.addr[1], info.cfg.addr[2], info.cfg.addr[3],
+			    info.cfg.port, info.latency_ms, info.failures,
+			    info.demoted ? " (demoted)" : "");
+	}
+
+	return 0;
+}
+
+static int cmd_server_add(const struct shell *shell, size_t argc, char *argv[])
+{
+	unsigned long port = CONFIG_APP_SERVER_PORT;
+	int err = 0;
+	int rc;
+
+	if (argc > 2) {
+		port = shell_strtoul(argv[2], 10, &err);
+	}
+	if (err || port > UINT16_MAX) {
+		shell_error(shell, "Usage: server add <ip> [port]");
+		return -EINVAL;
+	}
+
+	rc = endpoint_add(argv[1], port);
+	if (rc) {
+		shell_error(shell, "failed to add endpoint (err %d)", rc);
+		return rc;
+	}
+
+	shell_print(shell, "endpoint added");
+	return 0;
+}
+
+static int cmd_server_del(const struct shell *shell, size_t argc, char *argv[])
+{
+	unsigned long idx;
+	int err = 0;
+	int rc;
+
+	idx = shell_strtoul(argv[1], 10, &err);
+	if (err) {
+		shell_error(shell, "Usage: server del <index>");
+		return -EINVAL;
+	}
+
+	rc = endpoint_del(idx);
+	if (rc) {
+		shell_error(shell, "failed to delete endpoint (err %d)", rc);
+		return rc;
+	}
+
+	shell_print(shell, "endpoint deleted");
+	return 0;
+}
+
+/* clang-format off */
+SHELL_STATIC_SUBCMD_SET_CREATE(server_cmds,
+	SHELL_CMD_ARG(list, NULL, "List server endpoints", cmd_server_list, 1, 0),
+	SHELL_CMD_ARG(add, NULL, "Add server endpoint <ip> [port]", cmd_server_add, 2, 1),
+	SHELL_CMD_ARG(del, NULL, "Delete server endpoint <index>", cmd_server_del, 2, 0),
+	SHELL_SUBCMD_SET_END
+);
+/* clang-format on */
+
+static int cmd_channels(const struct shell *shell, size_t argc, char *argv[])
+{
+	const char *sensor;
+	const char *type;
+
+	for (size_t chan = 0; !sensor_reading_chan_name(chan, &sensor, &type); ++chan) {
+		shell_print(shell, "%zu: %s %s", chan, sensor, type);
+	}
+
+	return 0;
+}
+
+static int cmd_sched(const struct shell *shell, size_t argc, char *argv[])
+{
+	struct sensor_sched_stats stats;
+
+	sensor_sched_stats_get(&stats);
+
+	shell_print(shell, "ticks: %u missed: %u late: %u", stats.ticks, stats.missed,
+		    stats.late);
+	if (stats.ticks) {
+		shell_print(shell, "jitter us: min %lld avg %lld max %lld", stats.jitter_min_us,
+			    stats.jitter_sum_us / stats.ticks, stats.jitter_max_us);
+	}
+
+	return 0;
+}
+
+static int cmd_stats(const struct shell *shell, size_t argc, char *argv[])
+{
+	struct stats_hist_data data;
+
+	for (enum stats_counter cnt = 0; cnt < STATS_CNT_COUNT; ++cnt) {
+		shell_print(shell, "%-16s %u", stats_counter_name(cnt), stats_counter_get(cnt));
+	}
+
+	shell_print(shell, "%-16s %8s %8s %8s %8s %8s %8s", "latency (us)", "count", "min", "avg",
+		    "p50", "p99", "max");
+	for (enum stats_hist hist = 0; hist < STATS_HIST_COUNT; ++hist) {
+		stats_hist_get(hist, &data);
+		if (!data.count) {
+			continue;
+		}
+
+		shell_print(shell, "%-16s %8u %8u %8u %8u %8u %8u",
+			    hist < STATS_HIST_SENSOR_READ
+				    ? stats_hist_name(hist)
+				    : sensor_name(hist - STATS_HIST_SENSOR_READ),
+			    data.count, data.min_us, (uint32_t)(data.sum_us / data.count),
+			    stats_hist_percentile(&data, 50), stats_hist_percentile(&data, 99),
+			    data.max_us);
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_APP_MEM_REPORT
+static void mem_stack_print_cb(const char *name, size_t size, size_t unused, void *user_data)
+{
+	const struct shell *shell = user_data;
+
+	shell_print(shell, "%-20s %8zu %8zu %8zu", name, size, size - unused, unused);
+}
+
+static int cmd_mem(const struct shell *shell, size_t argc, char *argv[])
+{
+	struct mem_pool_usage pools[8];
+	size_t count;
+
+	shell_print(shell, "%-20s %8s %8s %8s", "stack", "size", "peak", "unused");
+	mem_stacks_foreach(mem_stack_print_cb, (void *)shell);
+
+	shell_print(shell, "%-20s %8s %8s %8s", "pool", "total", "peak", "used");
+	count = mem_pools_get(pools, ARRAY_SIZE(pools));
+	for (size_t i = 0; i < count; ++i) {
+		shell_print(shell, "%-20s %8zu %8zu %8zu", pools[i].name, pools[i].total,
+			    pools[i].peak, pools[i].used);
+	}
+
+	return 0;
+}
+#endif /* CONFIG_APP_MEM_REPORT */
+
+#ifdef CONFIG_APP_ALERT
+static int cmd_alert_list(const struct shell *shell, size_t argc, char *argv[])
+{
+	struct alert_rule rule;
+	const char *sensor;
+	const char *type;
+
+	for (size_t idx = 0; !alert_rule_get(idx, &rule); ++idx) {
+		if (sensor_reading_chan_name(rule.chan, &sensor, &type)) {
+			sensor = "?";
+			type = "?";
+		}
+		shell_print(shell, "%zu: chan %u (%s %s) %s %d", idx, rule.chan, sensor, type,
+			    alert_op_name(rule.op), rule.threshold);
+	}
+
+	return 0;
+}
+
+static int cmd_alert_add(const struct shell *shell, size_t argc, char *argv[])
+{
+	struct alert_rule rule;
+	unsigned long chan;
+	long threshold;
+	int err = 0;
+	int op;
+	int rc;
+
+	chan = shell_strtoul(argv[1], 10, &err);
+	op = alert_op_parse(argv[2]);
+	threshold = shell_strtol(argv[3], 10, &err);
+	if (err || op < 0 || chan > UINT8_MAX || threshold < INT32_MIN || threshold > INT32_MAX) {
+		shell_error(shell, "Usage: alert add <chan> <above|below|rate> <milli-units>");
+		return -EINVAL;
+	}
+
+	rule = (struct alert_rule){
+		.chan = chan,
+		.op = op,
+		.threshold = threshold,
+	};
+
+	rc = alert_rule_add(&rule);
+	if (rc) {
+		shell_error(shell, "failed to add alert rule (err %d)", rc);
+		return rc;
+	}
+
+	shell_print(shell, "alert rule added");
+	return 0;
+}
+
+static int cmd_alert_del(const struct shell *shell, size_t argc, char *argv[])
+{
+	unsigned long idx;
+	int err = 0;
+	int rc;
+
+	idx = shell_strtoul(argv[1], 10, &err);
+	if (err) {
+		shell_error(shell, "Usage: alert del <index>");
+		return -EINVAL;
+	}
+
+	rc = alert_rule_del(idx);
+	if (rc) {
+		shell_error(shell, "failed to delete alert rule (err %d)", rc);
+		return rc;
+	}
+
+	shell_print(shell, "alert rule deleted");
+	return 0;
+}
+
+/* clang-format off */
+SHELL_STATIC_SUBCMD_SET_CREATE(alert_cmds,
+	SHELL_CMD_ARG(list, NULL, "List alert rules", cmd_alert_list, 1, 0),
+	SHELL_CMD_ARG(add, NULL, "Add alert rule <chan> <above|below|rate> <milli-units>",
+		      cmd_alert_add, 4, 0),
+	SHELL_CMD_ARG(del, NULL, "Delete alert rule <index>", cmd_alert_del, 2, 0),
+	SHELL_SUBCMD_SET_END
+);
+/* clang-format on */
+#endif /* CONFIG_APP_ALERT */
+
+#ifdef CONFIG_APP_BENCH
+static void bench_print_cb(const struct bench_result *res, void *user_data)
+{
+	const struct shell *shell = user_data;
+
+	shell_print(shell,
+		    "name=%s size=%u ops=%u cycles_per_op=%u ns_per_op=%u bytes_per_op=%u "
+		    "result=%s",
+		    res->name, res->size, res->ops, res->cycles_per_op, res->ns_per_op,
+		    res->bytes_per_op, res->pass ? "PASS" : "FAIL");
+}
+
+static int cmd_bench_hotpath(const struct shell *shell, size_t argc, char *argv[])
+{
+	int rc;
+
+	rc = bench_hotpath(bench_print_cb, (void *)shell);
+	if (rc) {
+		shell_error(shell, "hot path benchmark failed (err %d)", rc);
+	}
+
+	return rc;
+}
+
+static void bench_latency_print_cb(const struct bench_latency *lat, void *user_data)
+{
+	const struct shell *shell = user_data;
+
+	shell_print(shell, "%-16s %-12s %6u %6u %6llu.%03u %6llu.%03u %6llu.%03u", lat->name,
+		    lat->detail, lat->samples, lat->errors, lat->min_ns / 1000,
+		    (uint32_t)(lat->min_ns % 1000), lat->avg_ns / 1000,
+		    (uint32_t)(lat->avg_ns % 1000), lat->p99_ns / 1000,
+		    (uint32_t)(lat->p99_ns % 1000));
+	if (lat->bytes && lat->avg_ns) {
+		shell_print(shell, "%-16s %u bytes, %llu KiB/s", "", lat->bytes,
+			    (uint64_t)lat->bytes * NSEC_PER_SEC / lat->avg_ns / 1024);
+	}
+}
+
+static void bench_latency_header(const struct shell *shell)
+{
+	shell_print(shell, "%-16s %-12s %6s %6s %10s %10s %10s", "name", "op", "count", "errors",
+		    "min (us)", "avg (us)", "p99 (us)");
+}
+
+static int bench_count_arg(const struct shell *shell, size_t argc, char *argv[], size_t pos,
+			   unsigned long def, unsigned long *val)
+{
+	int err = 0;
+
+	*val = argc > pos ? shell_strtoul(argv[pos], 10, &err) : def;
+	if (err || !*val) {
+		shell_error(shell, "bad count '%s'", argv[pos]);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int cmd_bench_sensor(const struct shell *shell, size_t argc, char *argv[])
+{
+	unsigned long count;
+	int rc;
+
+	rc = bench_count_arg(shell, argc, argv, 1, CONFIG_APP_BENCH_ITERATIONS, &count);
+	if (rc) {
+		return rc;
+	}
+
+	bench_latency_header(shell);
+	return bench_sensor(count, bench_latency_print_cb, (void *)shell);
+}
+
+static int cmd_bench_decode(const struct shell *shell, size_t argc, char *argv[])
+{
+	unsigned long count;
+	int rc;
+
+	rc = bench_count_arg(shell, argc, argv, 1, CONFIG_APP_BENCH_ITERATIONS, &count);
+	if (rc) {
+		return rc;
+	}
+
+	bench_latency_header(shell);
+	return bench_decode_chan(count, bench_latency_print_cb, (void *)shell);
+}
+
+static int cmd_bench_nvs(const struct shell *shell, size_t argc, char *argv[])
+{
+	unsigned long count;
+	int rc;
+
+	rc = bench_count_arg(shell, argc, argv, 1, CONFIG_APP_BENCH_ITERATIONS, &count);
+	if (rc) {
+		return rc;
+	}
+
+	bench_latency_header(shell);
+	return bench_nvs(count, bench_latency_print_cb, (void *)shell);
+}
+
+static int cmd_bench_sha1(const struct shell *shell, size_t argc, char *argv[])
+{
+	unsigned long count;
+	unsigned long kib;
+	int rc;
+
+	rc = bench_count_arg(shell, argc, argv, 1, 1, &kib);
+	if (rc) {
+		return rc;
+	}
+	if (kib > BENCH_SHA1_KIB_MAX) {
+		shell_error(shell, "at most %u KiB", BENCH_SHA1_KIB_MAX);
+		return -EINVAL;
+	}
+
+	rc = bench_count_arg(shell, argc, argv, 2, CONFIG_APP_BENCH_ITERATIONS, &count);
+	if (rc) {
+		return rc;
+	}
+
+	bench_latency_header(shell);
+	return bench_sha1(kib, count, bench_latency_print_cb, (void *)shell);
+}
+
+/* clang-format off */
+SHELL_STATIC_SUBCMD_SET_CREATE(bench_cmds,
+	SHELL_CMD_ARG(hotpath, NULL, "Sensor-to-payload hot path cost", cmd_bench_hotpath, 1, 0),
+	SHELL_CMD_ARG(sensor, NULL, "Back-to-back read latency per sensor [K]",
+		      cmd_bench_sensor, 1, 1),
+	SHELL_CMD_ARG(decode, NULL, "Decode latency per channel [K]", cmd_bench_decode, 1, 1),
+	SHELL_CMD_ARG(nvs, NULL,
+		      "NVS write and read latency [K <= 32], each write wears the flash",
+		      cmd_bench_nvs, 1, 1),
+	SHELL_CMD_ARG(sha1, NULL, "SHA1 latency and throughput [KiB <= 1024] [K]",
+		      cmd_bench_sha1, 1, 2),
+	SHELL_SUBCMD_SET_END
+);
+/* clang-format on */
+#endif /* CONFIG_APP_BENCH */
+
+#ifdef CONFIG_APP_HISTORY
+struct history_print_ctx {
+	const struct shell *shell;
+	enum history_tier tier;
+	size_t count;
+};
+
+static int history_print_cb(const struct history_point *point, void *user_data)
+{
+	struct history_print_ctx *ctx = user_data;
+
+	if (ctx->tier == HISTORY_TIER_RAW) {
+		shell_print(ctx->shell, "%u %s%d.%02d", point->ts,
+			    PRIq_arg(point->avg, 2, point->shift));
+	} else {
+		shell_print(ctx->shell, "%u %s%d.%02d %s%d.%02d %s%d.%02d", point->ts,
+			    PRIq_arg(point->min, 2, point->shift),
+			    PRIq_arg(point->avg, 2, point->shift),
+			    PRIq_arg(point->max, 2, point->shift));
+	}
+
+	ctx->count++;
+	return 0;
+}
+
+static int cmd_history_query(const struct shell *shell, size_t argc, char *argv[],
+			     enum history_tier tier)
+{
+	struct history_print_ctx ctx = {
+		.shell = shell,
+		.tier = tier,
+		.count = 0,
+	};
+	uint32_t now = history_now();
+	unsigned long chan;
+	unsigned long from;
+	unsigned long to;
+	int err = 0;
+	int rc;
+
+	chan = shell_strtoul(argv[1], 10, &err);
+	from = argc > 2 ? shell_strtoul(argv[2], 10, &err) : history_retention(tier);
+	to = argc > 3 ? shell_strtoul(argv[3], 10, &err) : 0;
+	if (err || from < to) {
+		shell_error(shell, "Usage: history %s <chan> [from_sec_ago] [to_sec_ago]",
+			    argv[0]);
+		return -EINVAL;
+	}
+
+	rc = history_query(tier, chan, now - MIN(from, now), now - MIN(to, now),
+			   history_print_cb, &ctx);
+	if (rc < 0) {
+		shell_error(shell, "history query failed (err %d)", rc);
+		return rc;
+	}
+
+	shell_print(shell, "%zu point(s)", ctx.count);
+	return 0;
+}
+
+static int cmd_history_raw(const struct shell *shell, size_t argc, char *argv[])
+{
+	return cmd_history_query(shell, argc, argv, HISTORY_TIER_RAW);
+}
+
+static int cmd_history_minute(const struct shell *shell, size_t argc, char *argv[])
+{
+	return cmd_history_query(shell, argc, argv, HISTORY_TIER_MINUTE);
+}
+
+static int cmd_history_hour(const struct shell *shell, size_t argc, char *argv[])
+{
+	return cmd_history_query(shell, argc, argv, HISTORY_TIER_HOUR);
+}
+
+/* clang-format off */
+SHELL_STATIC_SUBCMD_SET_CREATE(history_cmds,
+	SHELL_CMD_ARG(raw, NULL, "Raw samples <chan> [from_sec_ago] [to_sec_ago]",
+		      cmd_history_raw, 2, 2),
+	SHELL_CMD_ARG(minute, NULL, "1-minute min/avg/max <chan> [from_sec_ago] [to_sec_ago]",
+		      cmd_history_minute, 2, 2),
+	SHELL_CMD_ARG(hour, NULL, "1-hour min/avg/max <chan> [from_sec_ago] [to_sec_ago]",
+		      cmd_history_hour, 2, 2),
+	SHELL_SUBCMD_SET_END
+);
+/* clang-format on */
+#endif /* CONFIG_APP_HISTORY */
+
 SHELL_CMD_ARG_REGISTER(set_ssid, NULL, "Set WiFi SSID", cmd_set_ssid, 2, 0);
 SHELL_CMD_ARG_REGISTER(set_pass, NULL, "Set WiFi password", cmd_set_pass, 2, 0);
+SHELL_CMD_REGISTER(server, &server_cmds, "Manage server endpoints", NULL);
+SHELL_CMD_ARG_REGISTER(channels, NULL, "List sensor channels", cmd_channels, 1, 0);
+SHELL_CMD_ARG_REGISTER(stats, NULL, "Show performance metrics", cmd_stats, 1, 0);
+SHELL_CMD_ARG_REGISTER(sched, NULL, "Show sampling schedule statistics", cmd_sched, 1, 0);
+#ifdef CONFIG_APP_MEM_REPORT
+SHELL_CMD_ARG_REGISTER(mem, NULL, "Show stack and buffer pool usage", cmd_mem, 1, 0);
+#endif /* CONFIG_APP_MEM_REPORT */
+#ifdef CONFIG_APP_ALERT
+SHELL_CMD_REGISTER(alert, &alert_cmds, "Manage alert rules", NULL);
+#endif /* CONFIG_APP_ALERT */
+#ifdef CONFIG_APP_BENCH
+SHELL_CMD_REGISTER(bench, &bench_cmds, "On-device benchmarks", NULL);
+#endif /* CONFIG_APP_BENCH */
+#ifdef CONFIG_APP_HISTORY
+SHELL_CMD_REGISTER(history, &history_cmds, "Query on-device history", NULL);
+#endif /* CONFIG_APP_HISTORY */
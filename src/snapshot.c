@@ -0,0 +1,121 @@
+#include "http.h"
+#include "zbus.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/net/http/server.h>
+#include <zephyr/net/http/service.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/zbus/zbus.h>
+
+LOG_MODULE_REGISTER(snapshot, CONFIG_APP_LOG_LEVEL);
+
+#define SNAPSHOT_SIZE CONFIG_APP_SNAPSHOT_MAX_SIZE
+#define SNAPSHOT_HEAD "{\"seq\":%u,\"timestamp\":%lld,\"late\":%s,\"readings\":"
+
+/*
+ * The snapshot is encoded once per sample by the listener, in the sensor thread. Requests
+ * only copy the cached bytes out, so pollers never cause sensor reads or re-encoding.
+ */
+static char snapshot_work[SNAPSHOT_SIZE];
+static char snapshot_buf[SNAPSHOT_SIZE];
+static size_t snapshot_len;
+static struct k_spinlock snapshot_lock;
+
+/* Responses are sent by the single server thread right after the handler returns. */
+static char snapshot_tx[SNAPSHOT_SIZE];
+
+static uint16_t snapshot_port = CONFIG_APP_SNAPSHOT_PORT;
+
+HTTP_SERVICE_DEFINE(snapshot_service, NULL, &snapshot_port, CONFIG_HTTP_SERVER_MAX_CLIENTS, 4,
+		    NULL, NULL, NULL);
+
+static void snapshot_listener_cb(const struct zbus_channel *chan)
+{
+	const struct device_sensor_msg *msg = zbus_chan_const_msg(chan);
+	k_spinlock_key_t key;
+	int off;
+	int rc;
+
+	off = snprintf(snapshot_work, sizeof(snapshot_work), SNAPSHOT_HEAD, msg->seq,
+		       msg->timestamp, msg->late ? "true" : "false");
+	if (off < 0 || off >= sizeof(snapshot_work) - 1) {
+		return;
+	}
+
+	rc = http_payload_encode(msg, &snapshot_work[off], sizeof(snapshot_work) - off - 1);
+	if (rc) {
+		LOG_WRN("failed to encode snapshot (err %d)", rc);
+		return;
+	}
+	off += strlen(&snapshot_work[off]);
+	snapshot_work[off++] = '}';
+
+	key = k_spin_lock(&snapshot_lock);
+	memcpy(snapshot_buf, snapshot_work, off);
+	snapshot_len = off;
+	k_spin_unlock(&snapshot_lock, key);
+}
+
+ZBUS_LISTENER_DEFINE(snapshot_listener, snapshot_listener_cb);
+ZBUS_CHAN_ADD_OBS(environment_chan, snapshot_listener, 0);
+
+static int snapshot_handler(struct http_client_ctx *client, enum http_transaction_status status,
+			    const struct http_request_ctx *request_ctx,
+			    struct http_response_ctx *response_ctx, void *user_data)
+{
+	k_spinlock_key_t key;
+
+	if (status != HTTP_SERVER_REQUEST_DATA_FINAL) {
+		return 0;
+	}
+
+	key = k_spin_lock(&snapshot_lock);
+	memcpy(snapshot_tx, snapshot_buf, snapshot_len);
+	response_ctx->body_len = snapshot_len;
+	k_spin_unlock(&snapshot_lock, key);
+
+	if (!response_ctx->body_len) {
+		response_ctx->status = HTTP_503_SERVICE_UNAVAILABLE;
+	}
+	response_ctx->body = snapshot_tx;
+	response_ctx->final_chunk = true;
+
+	return 0;
+}
+
+static struct http_resource_detail_dynamic snapshot_detail = {
+	.common = {
+		.type = HTTP_RESOURCE_TYPE_DYNAMIC,
+		.bitmask_of_supported_http_methods = BIT(HTTP_GET),
+		.content_type = "application/json",
+	},
+	.cb = snapshot_handler,
+	.user_data = NULL,
+};
+
+HTTP_RESOURCE_DEFINE(snapshot_resource, snapshot_service, "/snapshot", &snapshot_detail);
+
+static int snapshot_init()
+{
+	int rc;
+
+	rc = http_server_start();
+	if (rc) {
+		LOG_ERR("failed to start snapshot server (err %d)", rc);
+		return rc;
+	}
+
+	LOG_INF("snapshot server on port %d", CONFIG_APP_SNAPSHOT_PORT);
+
+	return 0;
+}
+
+SYS_INIT(snapshot_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
@@ -0,0 +1,192 @@
+#include "stats.h"
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/util.h>
+
+#define STATS_BUCKET_SHIFT 6
+
+#define STATS_HEALTH_VERSION 1
+
+static atomic_t counters[STATS_CNT_COUNT];
+static struct stats_hist_data hists[STATS_HIST_COUNT];
+static struct k_spinlock hist_lock;
+
+static const char *const counter_names[STATS_CNT_COUNT] = {
+	[STATS_CNT_SAMPLES_DROPPED] = "samples_dropped",
+	[STATS_CNT_NET_RETRIES] = "net_retries",
+	[STATS_CNT_WIFI_FAILURES] = "wifi_failures",
+	[STATS_CNT_SERVER_FAILURES] = "server_failures",
+	[STATS_CNT_UPLOADS] = "uploads",
+	[STATS_CNT_UPLOAD_FAILURES] = "upload_failures",
+	[STATS_CNT_FIRST_PUBLISH_MS] = "first_publish_ms",
+};
+
+/* Histograms in the health block, in wire order. Append only, never reorder or remove. */
+static const enum stats_hist health_hists[] = {
+	STATS_HIST_WIFI_CONNECT,
+	STATS_HIST_TCP_CONNECT,
+	STATS_HIST_HTTP_RTT,
+	STATS_HIST_JSON_ENCODE,
+	STATS_HIST_TLS_CONNECT,
+	STATS_HIST_ALERT_LATENCY,
+	STATS_HIST_SENSOR_ROUND,
+	STATS_HIST_SENSOR_CPU,
+	STATS_HIST_CYCLE_CPU,
+};
+
+void stats_inc(enum stats_counter cnt)
+{
+	atomic_inc(&counters[cnt]);
+}
+
+void stats_add(enum stats_counter cnt, uint32_t value)
+{
+	atomic_add(&counters[cnt], value);
+}
+
+uint32_t stats_counter_get(enum stats_counter cnt)
+{
+	return (uint32_t)atomic_get(&counters[cnt]);
+}
+
+const char *stats_counter_name(enum stats_counter cnt)
+{
+	return counter_names[cnt];
+}
+
+/* Timing uses the system tick, so resolution is 1 / CONFIG_SYS_CLOCK_TICKS_PER_SEC. */
+int64_t stats_start()
+{
+	return k_uptime_ticks();
+}
+
+void stats_record(enum stats_hist hist, uint32_t us)
+{
+	struct stats_hist_data *data = &hists[hist];
+	size_t bucket = 0;
+	k_spinlock_key_t key;
+
+	if (us >> STATS_BUCKET_SHIFT) {
+		bucket = MIN(LOG2(us) - STATS_BUCKET_SHIFT + 1, STATS_HIST_BUCKETS - 1);
+	}
+
+	key = k_spin_lock(&hist_lock);
+
+	if (!data->count) {
+		data->min_us = us;
+		data->max_us = us;
+	}
+	data->count++;
+	data->min_us = MIN(data->min_us, us);
+	data->max_us = MAX(data->max_us, us);
+	data->sum_us += us;
+	data->buckets[bucket]++;
+
+	k_spin_unlock(&hist_lock, key);
+}
+
+void stats_record_since(enum stats_hist hist, int64_t start)
+{
+	stats_record(hist, (uint32_t)MIN(k_ticks_to_us_floor64(k_uptime_ticks() - start),
+					 UINT32_MAX));
+}
+
+void stats_hist_get(enum stats_hist hist, struct stats_hist_data *data)
+{
+	k_spinlock_key_t key = k_spin_lock(&hist_lock);
+
+	*data = hists[hist];
+
+	k_spin_unlock(&hist_lock, key);
+}
+
+const char *stats_hist_name(enum stats_hist hist)
+{
+	switch (hist) {
+	case STATS_HIST_WIFI_CONNECT:
+		return "wifi_connect";
+	case STATS_HIST_TCP_CONNECT:
+		return "tcp_connect";
+	case STATS_HIST_HTTP_RTT:
+		return "http_rtt";
+	case STATS_HIST_JSON_ENCODE:
+		return "json_encode";
+	case STATS_HIST_TLS_CONNECT:
+		return "tls_connect";
+	case STATS_HIST_ALERT_LATENCY:
+		return "alert_latency";
+	case STATS_HIST_SENSOR_ROUND:
+		return "sensor_round";
+	case STATS_HIST_SENSOR_CPU:
+		return "sensor_cpu";
+	case STATS_HIST_CYCLE_CPU:
+		return "cycle_cpu";
+	default:
+		return "sensor_read";
+	}
+}
+
+/* Upper bound of the bucket holding the given percentile, capped by the observed max. */
+uint32_t stats_hist_percentile(const struct stats_hist_data *data, uint8_t pct)
+{
+	uint64_t target = ((uint64_t)data->count * pct + 99) / 100;
+	uint64_t seen = 0;
+
+	for (size_t bucket = 0; bucket < STATS_HIST_BUCKETS; ++bucket) {
+		seen += data->buckets[bucket];
+		if (seen >= target && seen) {
+			return MIN(BIT(bucket + STATS_BUCKET_SHIFT), data->max_us);
+		}
+	}
+
+	return data->max_us;
+}
+
+/*
+ * Compact health block, positional to keep it short on every upload:
+ *
+ *   v<version>;<counter>;...;<counter>/<p50 ms>;...;<p50 ms>
+ *
+ * Counters in enum order, then the '/' separated p50 of the health_hists histograms. Both
+ * lists are append only, so a parser reading the fields it knows handles newer blocks too.
+ */
+int stats_health_format(char *buf, size_t len)
+{
+	struct stats_hist_data data;
+	size_t off;
+	int rc;
+
+	rc = snprintf(buf, len, "v%d", STATS_HEALTH_VERSION);
+	if (rc < 0 || rc >= len) {
+		return -ENOSPC;
+	}
+	off = rc;
+
+	for (enum stats_counter cnt = 0; cnt < STATS_CNT_COUNT; ++cnt) {
+		rc = snprintf(&buf[off], len - off, ";%u", stats_counter_get(cnt));
+		if (rc < 0 || rc >= len - off) {
+			return -ENOSPC;
+		}
+		off += rc;
+	}
+
+	ARRAY_FOR_EACH(health_hists, idx) {
+		stats_hist_get(health_hists[idx], &data);
+
+		rc = snprintf(&buf[off], len - off, "%c%u", idx ? ';' : '/',
+			      stats_hist_percentile(&data, 50) / USEC_PER_MSEC);
+		if (rc < 0 || rc >= len - off) {
+			return -ENOSPC;
+		}
+		off += rc;
+	}
+
+	return off;
+}
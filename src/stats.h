@@ -0,0 +1,62 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include "sensor_map.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define STATS_HIST_BUCKETS 18
+
+/* Append only: the health block lists counters in enum order. */
+enum stats_counter {
+	STATS_CNT_SAMPLES_DROPPED,
+	STATS_CNT_NET_RETRIES,
+	STATS_CNT_WIFI_FAILURES,
+	STATS_CNT_SERVER_FAILURES,
+	STATS_CNT_UPLOADS,
+	STATS_CNT_UPLOAD_FAILURES,
+	/* Set once: time from boot to the first accepted upload (ms). */
+	STATS_CNT_FIRST_PUBLISH_MS,
+	STATS_CNT_COUNT,
+};
+
+/* Per-sensor read latencies follow STATS_HIST_SENSOR_READ, one per env-sensors entry. */
+enum stats_hist {
+	STATS_HIST_WIFI_CONNECT,
+	STATS_HIST_TCP_CONNECT,
+	STATS_HIST_HTTP_RTT,
+	STATS_HIST_JSON_ENCODE,
+	STATS_HIST_TLS_CONNECT,
+	STATS_HIST_ALERT_LATENCY,
+	STATS_HIST_SENSOR_ROUND,
+	STATS_HIST_SENSOR_CPU,
+	STATS_HIST_CYCLE_CPU,
+	STATS_HIST_SENSOR_READ,
+	STATS_HIST_COUNT = STATS_HIST_SENSOR_READ + SENSOR_COUNT,
+};
+
+/* Bucket i counts samples below 2^(i + 6) us, the last bucket everything above. */
+struct stats_hist_data {
+	uint32_t count;
+	uint32_t min_us;
+	uint32_t max_us;
+	uint64_t sum_us;
+	uint32_t buckets[STATS_HIST_BUCKETS];
+};
+
+void stats_inc(enum stats_counter cnt);
+void stats_add(enum stats_counter cnt, uint32_t value);
+uint32_t stats_counter_get(enum stats_counter cnt);
+const char *stats_counter_name(enum stats_counter cnt);
+
+int64_t stats_start();
+void stats_record(enum stats_hist hist, uint32_t us);
+void stats_record_since(enum stats_hist hist, int64_t start);
+void stats_hist_get(enum stats_hist hist, struct stats_hist_data *data);
+const char *stats_hist_name(enum stats_hist hist);
+uint32_t stats_hist_percentile(const struct stats_hist_data *data, uint8_t pct);
+
+int stats_health_format(char *buf, size_t len);
+
+#endif // _STATS_H
@@ -29,8 +29,13 @@ BUILD_ASSERT(sizeof(CONFIG_APP_INITIAL_PASS) <= STORAGE_MAX_PASS_SIZE,
 enum storage_id {
 	STORAGE_ID_SSID,
 	STORAGE_ID_PASS,
+	STORAGE_ID_ENDPOINTS,
+	STORAGE_ID_ALERTS,
 };
 
+/* Benchmark entries live far from the settings ids, so a bench run never touches them. */
+#define STORAGE_ID_BENCH_BASE 0x8000
+
 static struct nvs_fs fs;
 
 ssize_t storage_ssid_get(char *data, size_t len)
@@ -62,6 +67,50 @@ ssize_t storage_pass_set(const char *data, size_t len)
 	return nvs_write(&fs, STORAGE_ID_PASS, data, len);
 }
 
+ssize_t storage_endpoints_get(void *data, size_t len)
+{
+	return nvs_read(&fs, STORAGE_ID_ENDPOINTS, data, len);
+}
+
+ssize_t storage_endpoints_set(const void *data, size_t len)
+{
+	return nvs_write(&fs, STORAGE_ID_ENDPOINTS, data, len);
+}
+
+ssize_t storage_alerts_get(void *data, size_t len)
+{
+	return nvs_read(&fs, STORAGE_ID_ALERTS, data, len);
+}
+
+ssize_t storage_alerts_set(const void *data, size_t len)
+{
+	return nvs_write(&fs, STORAGE_ID_ALERTS, data, len);
+}
+
+ssize_t storage_bench_get(size_t slot, void *data, size_t len)
+{
+	if (slot >= STORAGE_BENCH_SLOTS) {
+		return -EINVAL;
+	}
+	return nvs_read(&fs, STORAGE_ID_BENCH_BASE + slot, data, len);
+}
+
+ssize_t storage_bench_set(size_t slot, const void *data, size_t len)
+{
+	if (slot >= STORAGE_BENCH_SLOTS) {
+		return -EINVAL;
+	}
+	return nvs_write(&fs, STORAGE_ID_BENCH_BASE + slot, data, len);
+}
+
+int storage_bench_delete(size_t slot)
+{
+	if (slot >= STORAGE_BENCH_SLOTS) {
+		return -EINVAL;
+	}
+	return nvs_delete(&fs, STORAGE_ID_BENCH_BASE + slot);
+}
+
 static void storage_setup_defaults()
 {
 	ssize_t rc;
@@ -14,4 +14,19 @@ ssize_t storage_ssid_set(const char *buf, size_t len);
 ssize_t storage_pass_get(char *buf, size_t len);
 ssize_t storage_pass_set(const char *buf, size_t len);
 
+/* Array of struct endpoint_cfg; an empty array removes the entry. */
+ssize_t storage_endpoints_get(void *buf, size_t len);
+ssize_t storage_endpoints_set(const void *buf, size_t len);
+
+/* Array of struct alert_rule; an empty array removes the entry. */
+ssize_t storage_alerts_get(void *buf, size_t len);
+ssize_t storage_alerts_set(const void *buf, size_t len);
+
+/* Scratch entries used by the NVS latency benchmark, kept apart from the settings ids. */
+#define STORAGE_BENCH_SLOTS 4
+
+ssize_t storage_bench_get(size_t slot, void *buf, size_t len);
+ssize_t storage_bench_set(size_t slot, const void *buf, size_t len);
+int storage_bench_delete(size_t slot);
+
 #endif // _STORAGE_H
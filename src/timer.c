@@ -1,44 +1,171 @@
 #include "timer.h"
+#include "trace.h"
 #include "zbus.h"
 
+#include <stdbool.h>
+#include <stdint.h>
+
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
 #include <zephyr/zbus/zbus.h>
 
 LOG_MODULE_REGISTER(timer, CONFIG_APP_LOG_LEVEL);
 
+#define SENSOR_PERIOD_TICKS                                                                        \
+	k_ms_to_ticks_ceil64((int64_t)CONFIG_APP_SENSOR_INTERVAL * SEC_PER_MIN * MSEC_PER_SEC)
+
+#define SENSOR_LATE_THRESHOLD_US (CONFIG_APP_SENSOR_LATE_THRESHOLD_MS * USEC_PER_MSEC)
+
 /* clang-format off */
 ZBUS_CHAN_DEFINE(timer_chan,	/* Name */
-	 void*,						/* Message type */
+	 struct sensor_tick,		/* Message type */
 	 NULL,						/* Validator */
 	 NULL,						/* User data */
 	 ZBUS_OBSERVERS_EMPTY,		/* Observers */
-	 ZBUS_MSG_INIT(NULL)		/* Initial value */
+	 ZBUS_MSG_INIT(0)			/* Initial value */
 );
 /* clang-format on */
 
-static void sensor_timer_expiry_cb(struct k_timer *timer)
+static int64_t tick_start;
+static uint32_t tick_seq;
+static bool timer_running;
+static uint32_t phase_seed;
+
+static uint32_t next_seq;
+static struct sensor_sched_stats sched_stats;
+static struct k_spinlock sched_lock;
+
+static void sensor_tick_publish(const struct sensor_tick *tick)
 {
 	int rc;
 
-	LOG_DBG("timer expired");
+	LOG_DBG("timer expired (seq %u)", tick->seq);
+	APP_TRACE(TRACE_TICK, tick->seq, k_ticks_to_ms_floor64(tick->deadline));
 
-	rc = zbus_chan_pub(&timer_chan, timer, K_NO_WAIT);
+	rc = zbus_chan_pub(&timer_chan, tick, K_NO_WAIT);
 	if (rc) {
 		LOG_ERR("failed to publish timer event (err %d)", rc);
 	}
 }
 
+/*
+ * Deadlines are derived from the start time and the tick sequence number rather than
+ * from the time the previous tick was handled, so the sampling period cannot drift.
+ */
+static void sensor_timer_expiry_cb(struct k_timer *timer)
+{
+	struct sensor_tick tick = {
+		.seq = tick_seq,
+		.deadline = tick_start + (int64_t)tick_seq * SENSOR_PERIOD_TICKS,
+		.period = SENSOR_PERIOD_TICKS,
+	};
+
+	tick_seq++;
+	sensor_tick_publish(&tick);
+}
+
 static K_TIMER_DEFINE(sensor_timer, sensor_timer_expiry_cb, NULL);
 
+void sensor_timer_phase_set(uint32_t seed)
+{
+	phase_seed = seed;
+}
+
+/*
+ * Starting a running timer keeps its phase, so a late authorization does not resample.
+ *
+ * The first tick fires right away, the periodic ones are shifted by a per-device phase
+ * within the period so nodes that start together do not sample and upload in lockstep.
+ */
 void sensor_timer_start()
 {
-	LOG_INF("sensor timer started");
-	k_timer_start(&sensor_timer, K_NO_WAIT, K_MINUTES(CONFIG_APP_SENSOR_INTERVAL));
+	struct sensor_tick tick = {
+		.seq = 0,
+		.period = SENSOR_PERIOD_TICKS,
+	};
+	int64_t phase = phase_seed % SENSOR_PERIOD_TICKS;
+
+	if (timer_running) {
+		return;
+	}
+	timer_running = true;
+
+	if (phase == 0) {
+		phase = SENSOR_PERIOD_TICKS;
+	}
+
+	LOG_INF("sensor timer started (phase %lld ms)", k_ticks_to_ms_floor64(phase));
+
+	tick.deadline = k_uptime_ticks();
+	tick_seq = 1;
+	tick_start = tick.deadline + phase - SENSOR_PERIOD_TICKS;
+
+	sensor_tick_publish(&tick);
+	k_timer_start(&sensor_timer, K_TICKS(phase), K_TICKS(SENSOR_PERIOD_TICKS));
 };
 
 void sensor_timer_stop()
 {
 	LOG_INF("sensor timer stopped");
+	timer_running = false;
 	k_timer_stop(&sensor_timer);
 }
+
+static int64_t ticks_to_us_signed(int64_t ticks)
+{
+	if (ticks < 0) {
+		return -(int64_t)k_ticks_to_us_floor64(-ticks);
+	}
+	return (int64_t)k_ticks_to_us_floor64(ticks);
+}
+
+uint32_t sensor_sched_begin(const struct sensor_tick *tick)
+{
+	int64_t jitter_us = ticks_to_us_signed(k_uptime_ticks() - tick->deadline);
+	k_spinlock_key_t key;
+	uint32_t missed;
+
+	/* Sequence numbers restart whenever the timer is restarted. */
+	if (tick->seq < next_seq) {
+		next_seq = 0;
+	}
+	missed = tick->seq - next_seq;
+	next_seq = tick->seq + 1;
+
+	key = k_spin_lock(&sched_lock);
+
+	if (!sched_stats.ticks) {
+		sched_stats.jitter_min_us = jitter_us;
+		sched_stats.jitter_max_us = jitter_us;
+	}
+	sched_stats.ticks++;
+	sched_stats.missed += missed;
+	sched_stats.jitter_min_us = MIN(sched_stats.jitter_min_us, jitter_us);
+	sched_stats.jitter_max_us = MAX(sched_stats.jitter_max_us, jitter_us);
+	sched_stats.jitter_sum_us += jitter_us;
+	if (jitter_us > SENSOR_LATE_THRESHOLD_US) {
+		sched_stats.late++;
+	}
+
+	k_spin_unlock(&sched_lock, key);
+
+	if (missed) {
+		LOG_WRN("missed %u sampling tick(s) before seq %u", missed, tick->seq);
+	}
+	if (jitter_us > SENSOR_LATE_THRESHOLD_US) {
+		LOG_WRN("sampling tick %u late by %lld us", tick->seq, jitter_us);
+	}
+
+	return missed;
+}
+
+void sensor_sched_stats_get(struct sensor_sched_stats *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&sched_lock);
+
+	*stats = sched_stats;
+
+	k_spin_unlock(&sched_lock, key);
+}
@@ -1,7 +1,26 @@
 #ifndef _TIMER_H
 #define _TIMER_H
 
+#include <stdint.h>
+
+#include <zephyr/kernel.h>
+
+struct sensor_sched_stats {
+	uint32_t ticks;
+	uint32_t missed;
+	uint32_t late;
+	int64_t jitter_min_us;
+	int64_t jitter_max_us;
+	int64_t jitter_sum_us;
+};
+
+struct sensor_tick;
+
+void sensor_timer_phase_set(uint32_t seed);
 void sensor_timer_start();
 void sensor_timer_stop();
 
+uint32_t sensor_sched_begin(const struct sensor_tick *tick);
+void sensor_sched_stats_get(struct sensor_sched_stats *stats);
+
 #endif // _TIMER_H
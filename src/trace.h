@@ -0,0 +1,29 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+#include <stdint.h>
+
+#include <zephyr/tracing/tracing.h>
+
+/*
+ * Stages of one sample's lifecycle, each emitted as a named tracing event tagged with
+ * the sample (tick) sequence number. The second argument is stage specific.
+ */
+#define TRACE_TICK          "tick"          /* tick deadline (ms) */
+#define TRACE_SUBMIT        "rtio_submit"   /* sensor index */
+#define TRACE_CQE           "rtio_cqe"      /* sensor index */
+#define TRACE_DECODE        "decode"        /* sensor index */
+#define TRACE_PUBLISH       "zbus_publish"  /* reading count */
+#define TRACE_ENCODE        "json_encode"   /* payload length */
+#define TRACE_CONNECT_BEGIN "connect_begin" /* unused */
+#define TRACE_CONNECT       "connect"       /* socket or negative error */
+#define TRACE_HTTP_SEND     "http_send"     /* payload length */
+#define TRACE_HTTP_RESPONSE "http_response" /* HTTP status */
+
+#ifdef CONFIG_APP_TRACE
+#define APP_TRACE(stage, seq, arg) sys_trace_named_event(stage, (uint32_t)(seq), (uint32_t)(arg))
+#else
+#define APP_TRACE(stage, seq, arg)
+#endif
+
+#endif // _TRACE_H
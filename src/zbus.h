@@ -3,6 +3,7 @@
 
 #include "sensor_map.h"
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stddef.h>
 
@@ -10,9 +11,16 @@
 #include <zephyr/zbus/zbus.h>
 #include <zephyr/dsp/types.h>
 
+struct sensor_tick {
+	uint32_t seq;
+	int64_t deadline;
+	int64_t period;
+};
+
 struct sensor_reading {
 	const char *sensor;
 	const char *type;
+	uint8_t chan;
 	q31_t value;
 	int8_t shift;
 };
@@ -20,10 +28,24 @@ struct sensor_reading {
 struct device_sensor_msg {
 	struct sensor_reading readings[SENSOR_READINGS_MAX];
 	size_t count;
+	uint32_t seq;
+	/* Uptime of the read (ms); late is set for replays and rounds past the late threshold. */
+	int64_t timestamp;
+	bool late;
 	struct k_sem *sem;
 };
 
+/* A reading that triggered the given alert rule. */
+struct sensor_alert {
+	struct sensor_reading reading;
+	uint32_t seq;
+	int64_t timestamp;
+	uint8_t rule;
+	uint8_t op;
+};
+
 ZBUS_CHAN_DECLARE(timer_chan);
 ZBUS_CHAN_DECLARE(environment_chan);
+ZBUS_CHAN_DECLARE(alert_chan);
 
 #endif /* _ZBUS_H */
@@ -0,0 +1,41 @@
+#define DT_DRV_COMPAT vnd_env_sensor
+
+#include "fake_sensor.h"
+
+#include <errno.h>
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+
+/* No submit or decoder, so reads take the generic fetch/get path like the real drivers. */
+static int fake_sensor_sample_fetch(const struct device *dev, enum sensor_channel chan)
+{
+	return 0;
+}
+
+static int fake_sensor_channel_get(const struct device *dev, enum sensor_channel chan,
+				   struct sensor_value *val)
+{
+	switch (chan) {
+	case SENSOR_CHAN_AMBIENT_TEMP:
+		return sensor_value_from_milli(val, FAKE_SENSOR_TEMP_MILLI);
+	case SENSOR_CHAN_HUMIDITY:
+		return sensor_value_from_milli(val, FAKE_SENSOR_HUMID_MILLI);
+	case SENSOR_CHAN_PRESS:
+		return sensor_value_from_milli(val, FAKE_SENSOR_PRESS_MILLI);
+	default:
+		return -ENOTSUP;
+	}
+}
+
+static DEVICE_API(sensor, fake_sensor_api) = {
+	.sample_fetch = fake_sensor_sample_fetch,
+	.channel_get = fake_sensor_channel_get,
+};
+
+#define FAKE_SENSOR_DEFINE(inst)                                                                   \
+	SENSOR_DEVICE_DT_INST_DEFINE(inst, NULL, NULL, NULL, NULL, POST_KERNEL,                    \
+				     CONFIG_SENSOR_INIT_PRIORITY, &fake_sensor_api);
+
+DT_INST_FOREACH_STATUS_OKAY(FAKE_SENSOR_DEFINE)
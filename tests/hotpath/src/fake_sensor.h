@@ -0,0 +1,9 @@
+#ifndef _FAKE_SENSOR_H
+#define _FAKE_SENSOR_H
+
+/* Fixed readings of the fake environment sensor (in milli units of the sensor API). */
+#define FAKE_SENSOR_TEMP_MILLI  21500
+#define FAKE_SENSOR_HUMID_MILLI 45250
+#define FAKE_SENSOR_PRESS_MILLI 101325
+
+#endif // _FAKE_SENSOR_H
@@ -0,0 +1,11 @@
+/* Built into the native simulator runner, so this is compiled against the host C library. */
+#include <stdint.h>
+#include <time.h>
+
+uint64_t hotpath_host_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
@@ -0,0 +1,321 @@
+#include "fake_sensor.h"
+#include "http.h"
+#include "sensor.h"
+#include "sensor_map.h"
+#include "storage.h"
+#include "zbus.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/kernel.h>
+#include <zephyr/rtio/rtio.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/zbus/zbus.h>
+#include <zephyr/ztest.h>
+
+#define HOTPATH_ITERATIONS CONFIG_HOTPATH_ITERATIONS
+#define HOTPATH_NVS_SIZE   16
+
+#define HOTPATH_IODEV_SYM(idx)      CONCAT(_hotpath_iodev_, idx)
+#define HOTPATH_IODEV_PTR(idx, ...) &HOTPATH_IODEV_SYM(idx)
+
+/* clang-format off */
+#define HOTPATH_IODEV_DEFINE(node_id, prop, idx)	\
+		SENSOR_DT_READ_IODEV(						\
+			HOTPATH_IODEV_SYM(idx),					\
+			DT_PHANDLE_BY_IDX(node_id, prop, idx),	\
+			SENSOR_CHAN_MAP(						\
+				DT_PHANDLE_BY_IDX(node_id, prop, idx)))
+/* clang-format on */
+
+DT_FOREACH_PROP_ELEM_SEP(ZEPHYR_USER_NODE, env_sensors, HOTPATH_IODEV_DEFINE, (;));
+
+static struct rtio_iodev *iodevs[SENSOR_COUNT] = {LISTIFY(SENSOR_COUNT, HOTPATH_IODEV_PTR, (,))};
+
+RTIO_DEFINE(hotpath_ctx, 1, 1);
+
+static uint8_t hotpath_bufs[SENSOR_COUNT][SENSOR_BUF_BLOCK_SIZE];
+static char hotpath_json[CONFIG_APP_MAX_JSON_PAYLOAD];
+static struct device_sensor_msg hotpath_msg;
+static volatile uint32_t hotpath_sink;
+
+static void hotpath_listener_cb(const struct zbus_channel *chan)
+{
+	hotpath_sink++;
+}
+
+ZBUS_LISTENER_DEFINE(hotpath_listener, hotpath_listener_cb);
+
+/* clang-format off */
+ZBUS_CHAN_DEFINE(hotpath_chan,		/* Name */
+	 struct device_sensor_msg,		/* Message */
+	 NULL,							/* Validator */
+	 NULL,							/* User data */
+	 ZBUS_OBSERVERS(hotpath_listener),	/* Observers */
+	 ZBUS_MSG_INIT(0)				/* Initial value */
+);
+/* clang-format on */
+
+#ifdef CONFIG_ARCH_POSIX
+/* Host monotonic clock, see host_clock.c. */
+uint64_t hotpath_host_ns(void);
+#endif
+
+/* Elapsed time in ns; simulated time doesn't advance while code runs on native_sim. */
+static uint64_t hotpath_ns()
+{
+#if defined(CONFIG_ARCH_POSIX)
+	return hotpath_host_ns();
+#elif defined(CONFIG_TIMER_HAS_64BIT_CYCLE_COUNTER)
+	return k_cyc_to_ns_floor64(k_cycle_get_64());
+#else
+	return k_ticks_to_ns_floor64(k_uptime_ticks());
+#endif
+}
+
+/*
+ * Logs one machine-readable line per measurement and checks it against its budgets. Costs are
+ * per reading (per lookup or NVS entry where there is no reading), so configurations with a
+ * different SENSOR_READINGS_MAX stay comparable.
+ */
+static void hotpath_check(const char *name, uint32_t size, uint32_t readings, uint64_t ns,
+			  uint64_t bytes, uint32_t max_ns, uint32_t max_bytes)
+{
+	uint64_t ns_per_reading;
+	uint64_t bytes_per_reading;
+
+	zassert_true(readings > 0, "%s: nothing measured", name);
+
+	ns_per_reading = ns / readings;
+	bytes_per_reading = bytes / readings;
+
+	TC_PRINT("hotpath name=%s size=%u readings=%u ns_per_reading=%llu bytes_per_reading=%llu "
+		 "budget_ns=%u budget_bytes=%u\n",
+		 name, size, readings, (unsigned long long)ns_per_reading,
+		 (unsigned long long)bytes_per_reading, max_ns, max_bytes);
+
+	zassert_true(ns_per_reading <= max_ns, "%s: %llu ns per reading over the %u ns budget",
+		     name, (unsigned long long)ns_per_reading, max_ns);
+	zassert_true(!max_bytes || bytes_per_reading <= max_bytes,
+		     "%s: %llu bytes per reading over the %u bytes budget", name,
+		     (unsigned long long)bytes_per_reading, max_bytes);
+}
+
+static int32_t hotpath_expected_milli(int16_t chan)
+{
+	switch (chan) {
+	case SENSOR_CHAN_AMBIENT_TEMP:
+		return FAKE_SENSOR_TEMP_MILLI;
+	case SENSOR_CHAN_HUMIDITY:
+		return FAKE_SENSOR_HUMID_MILLI;
+	case SENSOR_CHAN_PRESS:
+		return FAKE_SENSOR_PRESS_MILLI;
+	default:
+		return 0;
+	}
+}
+
+static int64_t hotpath_q31_milli(q31_t value, int8_t shift)
+{
+	int64_t milli = (int64_t)value * 1000;
+
+	return shift >= 0 ? (milli * (1LL << shift)) >> 31 : milli >> (31 - shift);
+}
+
+/* Worst case readings: the longest sensor and type names, and the longest numbers. */
+static void hotpath_msg_fill(size_t count)
+{
+	struct sensor_read_config *cfg;
+	size_t chan = 0;
+
+	ARRAY_FOR_EACH(iodevs, idx) {
+		cfg = (struct sensor_read_config *)(iodevs[idx]->data);
+
+		for (size_t i = 0; i < cfg->count && chan < count; ++i, ++chan) {
+			hotpath_msg.readings[chan] = (struct sensor_reading){
+				.sensor = cfg->sensor->name,
+				.type = "humid",
+				.chan = chan,
+				.value = INT32_MIN,
+				.shift = INT8_MIN,
+			};
+		}
+	}
+
+	hotpath_msg.count = count;
+}
+
+ZTEST(hotpath, test_sensor_read)
+{
+	struct sensor_read_config *cfg;
+	uint64_t start;
+	int rc;
+
+	ARRAY_FOR_EACH(iodevs, idx) {
+		cfg = (struct sensor_read_config *)(iodevs[idx]->data);
+
+		start = hotpath_ns();
+		for (uint32_t it = 0; it < HOTPATH_ITERATIONS; ++it) {
+			rc = sensor_read(iodevs[idx], &hotpath_ctx, hotpath_bufs[idx],
+					 sizeof(hotpath_bufs[idx]));
+			zassert_ok(rc, "%s: read failed (err %d)", cfg->sensor->name, rc);
+		}
+
+		hotpath_check("sensor_read", cfg->count, HOTPATH_ITERATIONS * cfg->count,
+			      hotpath_ns() - start, 0, CONFIG_HOTPATH_SENSOR_READ_NS_MAX, 0);
+	}
+}
+
+ZTEST(hotpath, test_chan_type_str)
+{
+	const char *type;
+	uint64_t start;
+	uint32_t len = 0;
+
+	start = hotpath_ns();
+	for (uint32_t it = 0; it < HOTPATH_ITERATIONS; ++it) {
+		for (int16_t chan = 0; chan <= SENSOR_CHAN_ALL; ++chan) {
+			type = sensor_chan_type_str(chan);
+			len += type[0];
+		}
+	}
+	hotpath_check("chan_type_str", SENSOR_CHAN_ALL + 1,
+		      HOTPATH_ITERATIONS * (SENSOR_CHAN_ALL + 1), hotpath_ns() - start, 0,
+		      CONFIG_HOTPATH_CHAN_TYPE_NS_MAX, 0);
+	hotpath_sink = len;
+
+	zassert_str_equal(sensor_chan_type_str(SENSOR_CHAN_AMBIENT_TEMP), "temp");
+	zassert_str_equal(sensor_chan_type_str(SENSOR_CHAN_HUMIDITY), "humid");
+	zassert_str_equal(sensor_chan_type_str(SENSOR_CHAN_ALL), "unknown");
+}
+
+/* Decodes through sensor_decode(), the loop the sensor thread runs for every read. */
+ZTEST(hotpath, test_decode)
+{
+	struct sensor_reading *readings = hotpath_msg.readings;
+	struct sensor_read_config *cfg;
+	uint32_t count = 0;
+	uint8_t base = 0;
+	uint64_t ns = 0;
+	uint64_t start;
+	int64_t milli;
+	int rc;
+
+	ARRAY_FOR_EACH(iodevs, idx) {
+		cfg = (struct sensor_read_config *)(iodevs[idx]->data);
+
+		rc = sensor_read(iodevs[idx], &hotpath_ctx, hotpath_bufs[idx],
+				 sizeof(hotpath_bufs[idx]));
+		zassert_ok(rc, "%s: read failed (err %d)", cfg->sensor->name, rc);
+
+		rc = sensor_decode(cfg, hotpath_bufs[idx], base, &readings[base]);
+		zassert_equal(rc, cfg->count, "%s: decode failed (err %d)", cfg->sensor->name, rc);
+
+		for (size_t i = 0; i < cfg->count; ++i) {
+			struct sensor_reading *reading = &readings[base + i];
+
+			zassert_equal(reading->chan, base + i);
+			zassert_str_equal(reading->type,
+					  sensor_chan_type_str(cfg->channels[i].chan_type));
+
+			milli = hotpath_q31_milli(reading->value, reading->shift);
+			zassert_within(milli, hotpath_expected_milli(cfg->channels[i].chan_type), 1,
+				       "%s: channel %d decoded to %lld", cfg->sensor->name,
+				       cfg->channels[i].chan_type, (long long)milli);
+		}
+
+		start = hotpath_ns();
+		for (uint32_t it = 0; it < HOTPATH_ITERATIONS; ++it) {
+			sensor_decode(cfg, hotpath_bufs[idx], base, &readings[base]);
+		}
+		ns += hotpath_ns() - start;
+		count += HOTPATH_ITERATIONS * cfg->count;
+		base += cfg->count;
+	}
+
+	zassert_equal(base, SENSOR_READINGS_MAX, "readings don't add up to SENSOR_READINGS_MAX");
+	hotpath_check("decode", SENSOR_READINGS_MAX, count, ns, 0, CONFIG_HOTPATH_DECODE_NS_MAX,
+		      0);
+}
+
+ZTEST(hotpath, test_json_encode)
+{
+	uint64_t bytes;
+	uint64_t start;
+	int rc;
+
+	for (size_t count = 1; count <= SENSOR_READINGS_MAX; ++count) {
+		hotpath_msg_fill(count);
+		bytes = 0;
+
+		start = hotpath_ns();
+		for (uint32_t it = 0; it < HOTPATH_ITERATIONS; ++it) {
+			rc = http_payload_encode(&hotpath_msg, hotpath_json, sizeof(hotpath_json));
+			zassert_ok(rc, "%zu readings: encode failed (err %d)", count, rc);
+			bytes += strlen(hotpath_json);
+		}
+
+		hotpath_check("json_encode", count, HOTPATH_ITERATIONS * count,
+			      hotpath_ns() - start, bytes, CONFIG_HOTPATH_ENCODE_NS_MAX,
+			      CONFIG_HOTPATH_ENCODE_BYTES_MAX);
+	}
+}
+
+ZTEST(hotpath, test_zbus)
+{
+	uint64_t start;
+	int rc;
+
+	hotpath_msg_fill(SENSOR_READINGS_MAX);
+	hotpath_sink = 0;
+
+	start = hotpath_ns();
+	for (uint32_t it = 0; it < HOTPATH_ITERATIONS; ++it) {
+		hotpath_msg.seq = it;
+		rc = zbus_chan_pub(&hotpath_chan, &hotpath_msg, K_MSEC(100));
+		zassert_ok(rc, "publish failed (err %d)", rc);
+	}
+
+	hotpath_check("zbus", SENSOR_READINGS_MAX, HOTPATH_ITERATIONS * SENSOR_READINGS_MAX,
+		      hotpath_ns() - start, 0, CONFIG_HOTPATH_ZBUS_NS_MAX, 0);
+	zassert_equal(hotpath_sink, HOTPATH_ITERATIONS, "listener missed messages");
+}
+
+ZTEST(hotpath, test_nvs)
+{
+	uint32_t data[HOTPATH_NVS_SIZE / sizeof(uint32_t)];
+	uint64_t start;
+	ssize_t rc;
+
+	/* NVS skips writes of unchanged data, so every write carries a new pattern. */
+	start = hotpath_ns();
+	for (uint32_t it = 0; it < HOTPATH_ITERATIONS; ++it) {
+		for (size_t i = 0; i < ARRAY_SIZE(data); ++i) {
+			data[i] = it << 16 | i;
+		}
+
+		rc = storage_bench_set(it % STORAGE_BENCH_SLOTS, data, sizeof(data));
+		zassert_equal(rc, sizeof(data), "write failed (err %zd)", rc);
+	}
+	hotpath_check("nvs_write", sizeof(data), HOTPATH_ITERATIONS, hotpath_ns() - start, 0,
+		      CONFIG_HOTPATH_NVS_WRITE_NS_MAX, 0);
+
+	start = hotpath_ns();
+	for (uint32_t it = 0; it < HOTPATH_ITERATIONS; ++it) {
+		rc = storage_bench_get(it % STORAGE_BENCH_SLOTS, data, sizeof(data));
+		zassert_equal(rc, sizeof(data), "read failed (err %zd)", rc);
+	}
+	hotpath_check("nvs_read", sizeof(data), HOTPATH_ITERATIONS, hotpath_ns() - start, 0,
+		      CONFIG_HOTPATH_NVS_READ_NS_MAX, 0);
+
+	zassert_equal(data[ARRAY_SIZE(data) - 1],
+		      (HOTPATH_ITERATIONS - 1) << 16 | (ARRAY_SIZE(data) - 1),
+		      "read back stale data");
+	for (size_t slot = 0; slot < STORAGE_BENCH_SLOTS; ++slot) {
+		zassert_ok(storage_bench_delete(slot));
+	}
+}
+
+ZTEST_SUITE(hotpath, NULL, NULL, NULL, NULL, NULL);